@@ -3,7 +3,9 @@
 #ifndef DETECTION_MODEL_H
 #define DETECTION_MODEL_H
 
+#include <memory>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 // OpenCV2
@@ -11,13 +13,160 @@
 #include <opencv2/imgproc.hpp>
 #include <opencv2/dnn.hpp>
 
+#include "inference_workspace.hpp"
+#include "nms.hpp"
+
+/**
+ * @brief Single detected object, box in source frame pixels
+ * @note Plain data - class names and colors are resolved through the model's class_table
+*/
 struct detection
 {
+    float x = 0.0f;
+    float y = 0.0f;
+    float width = 0.0f;
+    float height = 0.0f;
     int class_id = 0;
-    std::string class_name{};
     float confidence = 0.0f;
-    cv::Scalar color{};
-    cv::Rect box{};
+
+    /**
+     * Id of the track the object belongs to on tracked sources (-1 - untracked)
+    */
+    int track_id = -1;
+
+    /**
+     * @returns box truncated to whole pixels
+    */
+    cv::Rect box() const { return cv::Rect(int(x), int(y), int(width), int(height)); }
+};
+
+static_assert(std::is_trivially_copyable_v<detection>, "detection records are copied around as plain memory");
+
+/**
+ * @brief Labels and colors of the classes a model detects, indexed by class id
+*/
+struct class_table
+{
+    std::vector<std::string> names{};
+    std::vector<cv::Scalar> colors{};
+
+    std::size_t size() const { return names.size(); }
+    const std::string& name(int class_id) const { return names.at(class_id); }
+    const cv::Scalar& color(int class_id) const { return colors.at(class_id); }
+};
+
+/**
+ * @brief Up to a max batch of frames moving through the inference stages (preprocess, forward, postprocess).
+ * @brief Owns every buffer the stages need, so stages of different jobs can run concurrently.
+ * @note Forward passes of a single model still have to be serialised by the caller
+*/
+struct inference_job
+{
+    /**
+     * Input tensor, network outputs and decoder scratch of this job
+    */
+    inference_workspace workspace{};
+
+    /**
+     * Number of frames in the job
+    */
+    std::size_t count = 0;
+
+    /**
+     * Slots of empty frames - they are fed blank and get no detections
+    */
+    std::vector<char> blank{};
+
+    /**
+     * One list of detected objects per frame, filled by postprocess
+    */
+    std::vector<std::vector<detection>> results{};
+
+    /**
+     * Result lists of a caller parked while its batch is smaller than the largest one, they keep their capacity
+    */
+    std::vector<std::vector<detection>> spare_results{};
+};
+
+/**
+ * @brief Numeric precision the network runs in
+*/
+enum class precision_mode
+{
+    fp32,
+    fp16,
+    int8
+};
+
+inline const char* to_string(precision_mode precision)
+{
+    switch(precision)
+    {
+        case precision_mode::fp16: return "fp16";
+        case precision_mode::int8: return "int8";
+        default: return "fp32";
+    }
+}
+
+struct model_options
+{
+    /**
+     * Maximum number of frames packed into a single forward pass
+    */
+    unsigned max_batch_size = 1;
+
+    /**
+     * Set when the model was exported with a static batch dimension.
+     * Batches are then always padded up to max_batch_size.
+    */
+    bool fixed_batch = false;
+
+    /**
+     * DNN backend and target the network is going to run on
+    */
+    cv::dnn::Backend backend = cv::dnn::DNN_BACKEND_CUDA;
+    cv::dnn::Target target = cv::dnn::DNN_TARGET_CUDA;
+
+    /**
+     * fp16 switches to the half precision variant of the target,
+     * int8 loads the quantized "<model>_int8.onnx" variant placed next to the model
+    */
+    precision_mode precision = precision_mode::fp32;
+
+    /**
+     * Suppress overlapping boxes only within the same class (class-agnostic otherwise)
+    */
+    bool class_aware_nms = false;
+
+    /**
+     * Only the best nms_top_k candidates of a frame go through NMS (0 - all of them)
+    */
+    unsigned nms_top_k = 0;
+
+    /**
+     * Maximum number of detections kept per frame (0 - no limit)
+    */
+    unsigned max_detections = 0;
+};
+
+/**
+ * @brief Latency of the warm-up passes at a single batch size
+*/
+struct warm_up_result
+{
+    unsigned batch_size = 0;
+    unsigned passes = 0;
+    double first_ms = 0.0;
+
+    /**
+     * Mean latency of the last passes
+    */
+    double stable_ms = 0.0;
+
+    /**
+     * Set once consecutive passes stayed within the tolerance before running out of passes
+    */
+    bool stabilised = false;
 };
 
 class detection_model
@@ -27,7 +176,13 @@ class detection_model
         const std::string model_name;
         const std::string dir_path;
         const cv::Size2f model_shape;
-        std::vector<std::string> classes{};
+        const model_options options;
+        std::shared_ptr<class_table> classes = std::make_shared<class_table>();
+
+        /**
+         * Job reused by object_detection_batch
+        */
+        inference_job local_job{};
 
     protected:
         /**
@@ -41,8 +196,8 @@ class detection_model
         virtual void load_classes() = 0;
 
     protected:
-        detection_model(const cv::Size2f& size ,const std::string& dir, const std::string& model) 
-            : model_name(model), dir_path(dir), model_shape(size) {};
+        detection_model(const cv::Size2f& size ,const std::string& dir, const std::string& model, const model_options& opts = {}) 
+            : model_name(model), dir_path(dir), model_shape(size), options(opts) {};
 
         detection_model(const detection_model&) = delete;
         detection_model(detection_model&&) = delete;
@@ -64,6 +219,26 @@ class detection_model
         */
         virtual auto get_colors() -> const std::vector<cv::Scalar>& = 0;
 
+        /**
+         * @returns class labels and colors shared with everything that outlives a single inference (results, publishers)
+        */
+        std::shared_ptr<const class_table> get_class_table() const { return classes; }
+
+        /**
+         * @returns maximum number of frames the model processes in a single forward pass
+        */
+        virtual unsigned get_max_batch_size() = 0;
+
+        /**
+         * @returns size of the network input (the tile size of tiled sources)
+        */
+        cv::Size get_input_shape() const { return cv::Size(model_shape); }
+
+        /**
+         * @returns NMS settings applied to the candidates of a frame, reused when merging the tiles of a frame
+        */
+        virtual nms::nms_params get_nms_params() const = 0;
+
         /**
          * @brief Performs object detection on a given image
          * @param img The image on which object detection will be performed
@@ -74,9 +249,57 @@ class detection_model
         /**
          * Performs object detection on a batch of images
          * @param batch batch of images
+         * @note Batches larger than the model's max batch size are split into several forward passes
          * @returns list for each image in the batch with detected objects per image
         */
         virtual auto object_detection_batch(const std::vector<cv::Mat>& batch) -> std::vector<std::vector<detection>> = 0;
+
+        /**
+         * Performs object detection on a batch of images reusing the caller's result buffers
+         * @param batch batch of images
+         * @param results [out] resized to the batch size, one list of detected objects per image
+         * @note Keep `results` alive between calls - the inner vectors keep their capacity
+        */
+        virtual void object_detection_batch(const std::vector<cv::Mat>& batch, std::vector<std::vector<detection>>& results) = 0;
+
+        /**
+         * @returns job with buffers sized for the max batch size, reusable for any number of passes
+        */
+        virtual std::unique_ptr<inference_job> create_job() = 0;
+
+        /**
+         * @brief Letterboxes and normalizes frames into the input tensor of the job
+         * @param frames first frame of the job
+         * @param count number of frames, at most the max batch size
+         * @note Touches the job only, safe to run concurrently with other stages of other jobs
+        */
+        virtual void preprocess(const cv::Mat* frames, std::size_t count, inference_job& job) = 0;
+
+        /**
+         * @brief Runs the network on the input tensor of the job
+         * @note Not reentrant - forward passes of one model have to be serialised
+        */
+        virtual void forward(inference_job& job) = 0;
+
+        /**
+         * @brief Decodes network outputs of the job into its results (NMS included)
+         * @note Touches the job only, safe to run concurrently with other stages of other jobs
+        */
+        virtual void postprocess(inference_job& job) = 0;
+
+        /**
+         * @brief Runs forward passes at every batch size the model is going to see until latency stabilises,
+         * @brief so lazy backend initialization and allocations do not hit the first real frames.
+         * @param max_passes upper bound of passes per batch size
+         * @param tolerance latency is stable once the spread of the last passes is within that fraction of the fastest one
+         * @returns report per batch size
+        */
+        virtual std::vector<warm_up_result> warm_up(unsigned max_passes = 10, double tolerance = 0.1);
+
+        /**
+         * @returns number of times the inference workspace had to grow (flat once the model is warm)
+        */
+        unsigned long long get_workspace_growth_events() const { return local_job.workspace.growth_events; }
         
         /**
          * @breif Applies detection results (bounding boxes) directly on a given image.
@@ -0,0 +1,77 @@
+#pragma once
+
+#ifndef INFERENCE_WORKSPACE_HPP
+#define INFERENCE_WORKSPACE_HPP
+
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "nms.hpp"
+#include "preprocess.hpp"
+
+/**
+ * @brief Buffers reused by every forward pass of a single model instance.
+ * @brief Everything only grows to its high-water mark, so steady-state inference does not touch the heap.
+*/
+struct inference_workspace
+{
+    /**
+     * Planar float32 NCHW input tensor sized for the max batch size
+    */
+    cv::Mat input;
+
+    /**
+     * Headers over the leading slots of the input tensor, input_views[n - 1] holds n images
+    */
+    std::vector<cv::Mat> input_views;
+
+    std::vector<std::string> output_names;
+    std::vector<cv::Mat> outputs;
+
+    // data of the outputs before the last forward pass, a blob the network (re)allocated shows up as a new pointer
+    std::vector<const uchar*> output_data;
+    std::vector<letterbox_transform> transforms;
+
+    // decoder scratch
+    std::vector<int> candidates;
+    std::vector<int> class_ids;
+    std::vector<float> confidences;
+    std::vector<cv::Rect2f> boxes;
+    std::vector<int> nms_result;
+    nms::nms_scratch nms;
+
+    /**
+     * Number of times any buffer had to grow (network outputs and NMS scratch included); stays flat once the workspace is warm
+    */
+    unsigned long long growth_events = 0;
+
+    /**
+     * @brief Resizes a buffer, counting a growth event when its capacity is exceeded
+    */
+    template <typename V>
+    void ensure_size(V& buffer, std::size_t size)
+    {
+        if(buffer.capacity() < size)
+            ++growth_events;
+
+        buffer.resize(size);
+    }
+
+    /**
+     * @brief Clears a buffer and makes room for `size` elements, counting a growth event when its capacity is exceeded
+    */
+    template <typename V>
+    void ensure_capacity(V& buffer, std::size_t size)
+    {
+        buffer.clear();
+
+        if(buffer.capacity() < size) {
+            ++growth_events;
+            buffer.reserve(size);
+        }
+    }
+};
+
+#endif // INFERENCE_WORKSPACE_HPP
@@ -0,0 +1,60 @@
+#pragma once
+
+#ifndef MODEL_REGISTRY_HPP
+#define MODEL_REGISTRY_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "detection_model.hpp"
+
+/**
+ * @brief Named model served by the detection service, sources select it by name on registration
+*/
+struct model_spec
+{
+    std::string name = "default";
+
+    // yolo version e.g. v8, v5
+    std::string type = "v8";
+
+    // onnx file in the models directory
+    std::string file{};
+
+    cv::Size shape{640, 640};
+
+    /**
+     * Cheaper input shapes every replica keeps compiled as well, sources step down to them under load (largest first)
+    */
+    std::vector<cv::Size> degraded_shapes{};
+
+    unsigned replicas = 1;
+    model_options options{};
+};
+
+/**
+ * @brief Reads the models to serve from a JSON array, e.g.
+ * @brief [{"name": "general", "model": "yolov8n.onnx"}, {"name": "plates", "model": "plates.onnx", "type": "v5", "shape": "320x320", "replicas": 2, "batch": 4, "precision": "fp16", "degrade": "256x256,192x192"}]
+ * @param defaults fields missing in an entry are taken from it (backend, NMS settings, batch...)
+ * @throws std::runtime_error on a malformed entry or a duplicated name
+*/
+std::vector<model_spec> load_model_specs(const std::string& path, const model_spec& defaults);
+
+/**
+ * @brief Parses a comma separated list of shapes e.g. "480x480,320x320", sorted from the largest one
+ * @throws std::runtime_error on a malformed shape
+*/
+std::vector<cv::Size> parse_shapes(const std::string& shapes);
+
+/**
+ * @brief Creates a (not warmed up) replica of the model
+*/
+std::unique_ptr<detection_model> create_model(const model_spec& spec, const std::string& dir);
+
+/**
+ * @brief Creates a (not warmed up) replica of the model at full resolution followed by its variants at the degraded shapes
+*/
+std::vector<std::unique_ptr<detection_model>> create_model_variants(const model_spec& spec, const std::string& dir);
+
+#endif // MODEL_REGISTRY_HPP
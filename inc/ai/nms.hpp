@@ -0,0 +1,94 @@
+#pragma once
+
+#ifndef NMS_HPP
+#define NMS_HPP
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+/**
+ * @brief Non-maximum suppression working on float boxes.
+ * @brief Kept boxes are bucketed on a coarse spatial grid, so a candidate is only compared with the boxes around it.
+*/
+namespace nms
+{
+    struct nms_params
+    {
+        /**
+         * Candidates with a score not above the threshold are ignored
+        */
+        float score_threshold = 0.0f;
+
+        /**
+         * A candidate is suppressed when its IoU with a kept box is above the threshold
+        */
+        float iou_threshold = 0.5f;
+
+        /**
+         * Suppress only between boxes of the same class (class-agnostic otherwise)
+        */
+        bool class_aware = false;
+
+        /**
+         * Only the top_k best scoring candidates take part in NMS (0 - all of them)
+        */
+        std::size_t top_k = 0;
+
+        /**
+         * Stop once that many boxes are kept (0 - no limit)
+        */
+        std::size_t max_detections = 0;
+    };
+
+    /**
+     * @brief Candidates of a single image
+     * @note class_ids may be null in class-agnostic mode
+    */
+    struct nms_input
+    {
+        const cv::Rect2f* boxes = nullptr;
+        const float* scores = nullptr;
+        const int* class_ids = nullptr;
+        std::size_t count = 0;
+    };
+
+    /**
+     * @brief Buffers of a suppression, reused between calls
+    */
+    struct nms_scratch
+    {
+        std::vector<std::pair<float, int>> order;
+        std::vector<std::vector<int>> cells;
+        std::vector<int> touched;
+    };
+
+    /**
+     * @brief Suppresses overlapping candidates of a single image
+     * @param input candidates
+     * @param params thresholds and limits
+     * @param keep [out] indices of the kept candidates, best score first
+     * @note Ties in score keep the candidate order, the same way cv::dnn::NMSBoxes does
+     * @note Works in a scratch of the calling thread
+    */
+    void suppress(const nms_input& input, const nms_params& params, std::vector<int>& keep);
+
+    /**
+     * @brief Suppresses overlapping candidates of a single image in the caller's buffers
+     * @param scratch [in, out] buffers of the suppression, they only grow
+     * @param growth_events [in, out] incremented every time `keep` or a scratch buffer had to grow
+    */
+    void suppress(const nms_input& input, const nms_params& params, std::vector<int>& keep, nms_scratch& scratch, unsigned long long& growth_events);
+
+    /**
+     * @brief Suppresses overlapping candidates of every image of a batch, images are processed in parallel
+     * @param inputs candidates of every image
+     * @param params thresholds and limits shared by the batch
+     * @param keep [out] resized to the batch size, indices of the kept candidates per image
+    */
+    void suppress_batch(const std::vector<nms_input>& inputs, const nms_params& params, std::vector<std::vector<int>>& keep);
+}
+
+#endif // NMS_HPP
@@ -0,0 +1,57 @@
+#pragma once
+
+#ifndef PRECISION_REPORT_HPP
+#define PRECISION_REPORT_HPP
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "detection_model.hpp"
+
+/**
+ * @brief Speed and accuracy of one precision mode over a set of frames, accuracy measured against FP32
+*/
+struct precision_report
+{
+    precision_mode precision = precision_mode::fp32;
+    std::size_t frames = 0;
+
+    // latency per frame
+    double mean_ms = 0.0;
+    double p50_ms = 0.0;
+    double p95_ms = 0.0;
+    double fps = 0.0;
+
+    /**
+     * FP32 detections matched by a detection of the same class with IoU >= 0.5
+    */
+    std::size_t matched = 0;
+
+    /**
+     * FP32 detections without a match / detections FP32 did not produce
+    */
+    std::size_t missing = 0;
+    std::size_t extra = 0;
+
+    // deviation of the matched detections
+    double mean_iou = 0.0;
+    double mean_score_delta = 0.0;
+    double max_score_delta = 0.0;
+};
+
+using model_factory = std::function<std::unique_ptr<detection_model>(const model_options&)>;
+
+/**
+ * @brief Runs the same frames through the model in every precision mode and compares the results with FP32
+ * @param factory creates the model for given options
+ * @param options options shared by every run, only the precision changes
+ * @param frames local frames, processed one at a time
+ * @param modes precision modes to compare (FP32 always runs first as the reference)
+ * @returns report per mode that could be loaded
+*/
+std::vector<precision_report> compare_precisions(
+    const model_factory& factory, const model_options& options,
+    const std::vector<cv::Mat>& frames, const std::vector<precision_mode>& modes);
+
+#endif // PRECISION_REPORT_HPP
@@ -0,0 +1,36 @@
+#pragma once
+
+#ifndef PREPROCESS_HPP
+#define PREPROCESS_HPP
+
+#include <opencv2/opencv.hpp>
+
+/**
+ * @brief Maps coordinates of the model input back to the source frame
+ * @note source = (model - offset) * scale
+*/
+struct letterbox_transform
+{
+    cv::Point2f scale{1.0f, 1.0f};
+    cv::Point2f offset{0.0f, 0.0f};
+};
+
+/**
+ * @brief Letterboxes, resizes (bilinear), swaps BGR to RGB and normalizes to [0, 1] in a single pass
+ * @brief writing straight into the planes of one image of a planar float32 NCHW tensor.
+ * @param src 8-bit BGR frame (gray and BGRA frames are converted first)
+ * @param dst first (R) plane of the image inside the tensor, planes are shape.area() floats apart
+ * @param shape model input size
+ * @param keep_aspect scale uniformly and pad the rest (letterbox) instead of stretching the frame
+ * @param pad_value value the pad area is filled with
+ * @returns transform mapping boxes back to the source frame
+ * @note The resized frame is placed in the top-left corner of the model input
+*/
+letterbox_transform letterbox_to_tensor(const cv::Mat& src, float* dst, const cv::Size& shape, bool keep_aspect, float pad_value = 0.0f);
+
+/**
+ * @brief Fills the planes of one image of a planar float32 NCHW tensor with a constant
+*/
+void fill_tensor_image(float* dst, const cv::Size& shape, float value);
+
+#endif // PREPROCESS_HPP
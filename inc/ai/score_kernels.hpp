@@ -0,0 +1,67 @@
+#pragma once
+
+#ifndef SCORE_KERNELS_HPP
+#define SCORE_KERNELS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Hot loops of the YOLO output decoders and of the frame change detection.
+ * @brief Every kernel has a scalar implementation and SIMD variants (AVX2, AVX-512, NEON) picked at runtime.
+*/
+namespace kernels
+{
+    /**
+     * @brief Finds the best class of every anchor in a class-major (planar) score tensor
+     * and compacts the anchors whose best score is above the threshold.
+     * @param scores first class plane; plane c starts at scores + c * stride
+     * @param classes number of class planes
+     * @param anchors number of anchors in every plane
+     * @param stride distance (in floats) between two consecutive class planes
+     * @param threshold exclusive lower bound of a kept score
+     * @param indices [out] anchor index of every kept anchor (room for `anchors` elements)
+     * @param class_ids [out] best class of every kept anchor (room for `anchors` elements)
+     * @param class_scores [out] best score of every kept anchor (room for `anchors` elements)
+     * @returns number of kept anchors
+     * @note Ties resolve to the lowest class id, the same way cv::minMaxLoc does
+    */
+    std::size_t planar_argmax_select(
+        const float* scores, std::size_t classes, std::size_t anchors, std::size_t stride, float threshold,
+        int* indices, int* class_ids, float* class_scores);
+
+    /**
+     * @brief Scans one column of a row-major tensor and compacts the rows whose value is not below the threshold.
+     * @param column first value of the column; row r holds its value at column + r * stride
+     * @param rows number of rows
+     * @param stride distance (in floats) between two consecutive rows
+     * @param threshold inclusive lower bound of a kept value
+     * @param indices [out] index of every kept row (room for `rows` elements)
+     * @returns number of kept rows
+    */
+    std::size_t strided_threshold_select(const float* column, std::size_t rows, std::size_t stride, float threshold, int* indices);
+
+    /**
+     * @brief Finds the maximum of a contiguous row
+     * @param row first element
+     * @param length number of elements (at least 1)
+     * @param best [out] maximum value
+     * @returns index of the first occurrence of the maximum
+    */
+    int row_argmax(const float* row, std::size_t length, float& best);
+
+    /**
+     * @brief Sum of absolute differences of two byte arrays (e.g. grayscale thumbnails)
+     * @param a first array
+     * @param b second array
+     * @param length number of bytes in each array
+    */
+    std::uint64_t sum_abs_diff(const std::uint8_t* a, const std::uint8_t* b, std::size_t length);
+
+    /**
+     * @returns name of the instruction set the kernels dispatch to (e.g. "avx2")
+    */
+    const char* instruction_set();
+}
+
+#endif // SCORE_KERNELS_HPP
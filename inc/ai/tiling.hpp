@@ -0,0 +1,42 @@
+#pragma once
+
+#ifndef TILING_HPP
+#define TILING_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include "detection_model.hpp"
+#include "nms.hpp"
+
+/**
+ * @brief Sliced inference of frames much larger than the model input.
+ * @brief A frame is cut into overlapping model-sized tiles (plus an optional downscaled view of the whole frame),
+ * @brief every tile goes through the model as one image of the batch and the results are merged in frame coordinates.
+*/
+namespace tiling
+{
+    /**
+     * @brief Splits a frame into overlapping tiles spread evenly over it
+     * @param frame size of the frame
+     * @param tile preferred tile size, usually the model input
+     * @param overlap minimum overlap of neighbouring tiles as a fraction of the tile size [0, 0.9]
+     * @param global_view append the whole frame as the last region, catches objects larger than a tile
+     * @param max_tiles upper bound of regions (the model batch size), tiles grow until the plan fits
+     * @returns regions in frame coordinates, a single region covering the frame when it fits one tile
+    */
+    std::vector<cv::Rect> plan(const cv::Size& frame, const cv::Size& tile, float overlap, bool global_view, std::size_t max_tiles);
+
+    /**
+     * @brief Maps the detections of every region back to the frame and suppresses duplicates across regions
+     * @param results detections of each region, in region coordinates
+     * @param regions regions the results belong to
+     * @param count number of regions
+     * @param params NMS settings of the model
+     * @param merged [out] detections in frame coordinates
+     * @param ws workspace of the postprocessed job, its decoder and NMS buffers are reused and their growth counted
+    */
+    void merge(const std::vector<detection>* results, const cv::Rect* regions, std::size_t count, const nms::nms_params& params, std::vector<detection>& merged, inference_workspace& ws);
+}
+
+#endif // TILING_HPP
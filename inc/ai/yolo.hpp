@@ -7,6 +7,7 @@
 #include <spdlog/spdlog.h>
 
 #include "detection_model.hpp"
+#include "preprocess.hpp"
 
 class yolo : public detection_model
 {
@@ -16,18 +17,39 @@ class yolo : public detection_model
         float modelNMSThreshold        {0.50f};
 
         bool letterBoxForSquare = true;
-        std::vector<cv::Scalar> colors{};
 
     private:
         virtual void load_model() override;
         virtual void load_classes() override;
 
     protected:
-        virtual cv::Mat formatToSquare(const cv::Mat& source);
+        /**
+         * @brief Letterboxes and normalizes a frame straight into its slot of the input tensor
+         * @param frame source frame (an empty frame leaves a blank slot)
+         * @param ws workspace holding the input tensor
+         * @param slot index of the image within the batch
+         * @returns transform mapping model coordinates back to the source frame
+        */
+        virtual letterbox_transform prepare_input(const cv::Mat& frame, inference_workspace& ws, std::size_t slot);
+
+        /**
+         * @returns input tensor holding the first `count` slots (the whole tensor for static batch models)
+        */
+        cv::Mat input_tensor(const inference_workspace& ws, std::size_t count);
+
+        /**
+         * @brief Allocates the input tensor and per-image buffers of a job for the max batch size
+        */
+        void init_job(inference_job& job);
 
     public:
-        yolo(const cv::Size2f& size, const std::string& dir, const std::string& model);
+        yolo(const cv::Size2f& size, const std::string& dir, const std::string& model, const model_options& options = {});
         virtual ~yolo() = default;
+
+        virtual std::unique_ptr<inference_job> create_job() override;
+        virtual void preprocess(const cv::Mat* frames, std::size_t count, inference_job& job) override;
+        virtual void forward(inference_job& job) override;
+        virtual nms::nms_params get_nms_params() const override;
 };
 
 
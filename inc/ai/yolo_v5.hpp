@@ -9,11 +9,12 @@
 
 class yolo_v5 : public yolo_v8
 {
+    protected:
+        virtual void decode_output(const cv::Mat& output, const letterbox_transform& transform, inference_workspace& ws, std::vector<detection>& detections) override;
+
     public:
-        yolo_v5(cv::Size2f shape, const std::string& dir, const std::string& model);
+        yolo_v5(cv::Size2f shape, const std::string& dir, const std::string& model, const model_options& options = {});
         virtual ~yolo_v5() = default;
-
-        virtual std::vector<detection> object_detection(const cv::Mat& img) override;
 };
 
-#endif // YOLO_V5_H
\ No newline at end of file
+#endif // YOLO_V5_H
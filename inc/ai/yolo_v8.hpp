@@ -7,17 +7,35 @@
 
 class yolo_v8 : public yolo
 {
+    protected:
+        /**
+         * @brief Decodes raw network output of a single image from the batch
+         * @param output 2D output plane of one image
+         * @param transform maps model coordinates back to the source image
+         * @param ws decoder scratch
+         * @param detections [out] list of detected objects after NMS
+        */
+        virtual void decode_output(const cv::Mat& output, const letterbox_transform& transform, inference_workspace& ws, std::vector<detection>& detections);
+
+        /**
+         * @brief Runs NMS over the boxes decoded into the workspace and fills the detections
+        */
+        void collect_detections(inference_workspace& ws, std::vector<detection>& detections);
+
     public:
-        yolo_v8(const cv::Size2f& size, const std::string& dir, const std::string& model);
+        yolo_v8(const cv::Size2f& size, const std::string& dir, const std::string& model, const model_options& options = {});
         virtual ~yolo_v8() = default;
 
         virtual const std::vector<std::string>& get_classes() override;
         virtual const std::vector<cv::Scalar>& get_colors() override;
+        virtual unsigned get_max_batch_size() override;
 
         virtual const std::string_view get_model_name() override;
         virtual std::vector<detection> object_detection(const cv::Mat& img) override;
         virtual std::vector<std::vector<detection>> object_detection_batch(const std::vector<cv::Mat>& batch) override;
+        virtual void object_detection_batch(const std::vector<cv::Mat>& batch, std::vector<std::vector<detection>>& results) override;
+        virtual void postprocess(inference_job& job) override;
         virtual cv::Mat apply_detections_on_image(const cv::Mat& img, const std::vector<detection>& detections) override;
 };
 
-#endif // YOLO_V8_H
\ No newline at end of file
+#endif // YOLO_V8_H
@@ -10,6 +10,8 @@
 #include <boost/json.hpp>
 
 #include "basic_publisher.hpp"
+#include "../service/frame_trace.hpp"
+#include "../service/result_info.hpp"
 
 /**
  * @note Join Rabbitmq client before injecting it to the class
@@ -24,8 +26,9 @@ class data_publisher : public basic_publisher
                 virtual ~converter() = default;
                 /**
                  * @brief Converts detections list into another data format
+                 * @param classes labels and colors the class ids of the detections refer to
                 */
-                virtual std::string convert(const std::vector<detection>& results) = 0;
+                virtual std::string convert(const std::vector<detection>& results, const class_table& classes) = 0;
         };
 
     protected:
@@ -37,8 +40,17 @@ class data_publisher : public basic_publisher
         data_publisher(std::shared_ptr<rabbitmq_client> client, std::unique_ptr<converter>& data_converter);
         virtual ~data_publisher() = default;
 
-        bool publish(unsigned src_id, const std::vector<detection>& results);
-        bool publish(unsigned src_id, const std::vector<detection>& results, unsigned limit);
+        bool publish(unsigned src_id, const std::vector<detection>& results, const class_table& classes);
+        bool publish(unsigned src_id, const std::vector<detection>& results, const class_table& classes, unsigned limit);
+
+        /**
+         * @brief Publishes results recording the serialize and publish stages of the frame
+         * @note The producer's capture timestamp is echoed in the "captured" header
+         * @note Reused detections of an unchanged scene are marked with the "carried_over" and "result_age_ms" headers,
+         * @note boxes predicted by the tracker with the "predicted" header, results of duplicate frames with the "cached" header,
+         * @note the input resolution of the network with the "resolution" header (e.g. "480x480")
+        */
+        bool publish(unsigned src_id, const std::vector<detection>& results, const class_table& classes, frame_trace& trace, const result_info& info = {});
 };
 
 /**
@@ -54,7 +66,7 @@ class json_converter : public data_publisher::converter
          * @brief Converts detections list into JSON data
          * @returns JSON
         */
-        virtual std::string convert(const std::vector<detection>& results) override;
+        virtual std::string convert(const std::vector<detection>& results, const class_table& classes) override;
 };
 
 #endif // DATA_PUBLISHER_H
\ No newline at end of file
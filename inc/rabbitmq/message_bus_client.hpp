@@ -4,6 +4,8 @@
 
 #include <string_view>
 #include <optional>
+#include <future>
+#include <functional>
 #include <thread>
 #include <unordered_set>
 #include <memory>
@@ -70,6 +72,21 @@ class message_bus_client
         AMQP::Address address;
         RabbitMqHandler m_handler;
 
+        /**
+         * Action postponed until a readiness signal fires, polled by a timer on the client's event loop
+        */
+        struct deferred_action
+        {
+            std::shared_future<void> readiness;
+            std::function<void()> action;
+            event* timer = nullptr;
+
+            ~deferred_action() { if(timer) event_free(timer); }
+        };
+
+        std::vector<std::unique_ptr<deferred_action>> deferred_actions;
+        const std::chrono::milliseconds readiness_poll_interval{20};
+
     protected:
         std::unique_ptr<AMQP::TcpConnection> m_connection;
         std::unique_ptr<AMQP::TcpChannel> channel;
@@ -96,10 +113,19 @@ class message_bus_client
         bool publish(const std::string_view &exchange, const std::string_view &routingKey, const AMQP::Envelope &envelope, int flags = 0);
         bool publish(const std::string_view &exchange, const std::string_view &routingKey, const std::string &message, int flags = 0);
 
+        /**
+         * @brief Runs the action on the client's event loop once the readiness signal is set (e.g. start consuming once the model is warm)
+         * @param readiness signal; if it carries an exception the action is dropped
+         * @param action typically declares/binds listeners
+         * @note not thread-safe, call before client_run()
+        */
+        client_ref when_ready(std::shared_future<void> readiness, std::function<void()> action);
+
         virtual ~message_bus_client() = default;
 
     private:
         void restore();
+        static void poll_readiness(evutil_socket_t, short, void* arg);
         void connection_init();
         void channel_init();
 };
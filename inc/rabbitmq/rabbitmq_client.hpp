@@ -3,19 +3,16 @@
 #ifndef RABBITMQ_CLIENT_H
 #define RABBITMQ_CLIENT_H
 
+#include <memory>
 #include <vector>
 #include <string>
 
 #include <boost/property_tree/json_parser.hpp>
 
 #include "message_bus_client.hpp"
+#include "../service/decode_pool.hpp"
 #include "../service/detection_service.hpp"
-
-struct source
-{
-    unsigned id;
-    std::string exchange;
-};
+#include "../service/source_options.hpp"
 
 /**
  * @warning Do not share among threads. Connection and channel are not thread-safe because of the implementation of AMQP-CPP
@@ -27,6 +24,12 @@ class rabbitmq_client : public message_bus_client
         const std::string new_source_que_name = "";
         const std::string obsolete_source_que_name = "";
 
+        // frames received on this client, numbers the frame traces
+        unsigned long long frames_received = 0;
+
+        // compressed frames are decoded inline on the client thread without it
+        std::unique_ptr<decode_pool> decoder{};
+
     public:
         rabbitmq_client(const std::string_view& connection_string);
         rabbitmq_client(const std::string& av_que, const std::string& obsolete_que, const std::string_view& connection_string);
@@ -37,8 +40,16 @@ class rabbitmq_client : public message_bus_client
         rabbitmq_client& bind_available_sources(const std::string& exchange, detection_service_visitor<cv::Mat>* visitor);
         rabbitmq_client& bind_obsolete_sources(const std::string& exchange, detection_service_visitor<cv::Mat>* visitor);
 
-        bool validate_json(boost::property_tree::ptree ptree, source& src);
-        auto source_from_json(std::string s) -> std::optional<source>;
+        /**
+         * @brief Decodes compressed frames on a pool of workers instead of the client thread
+         * @param threads decode workers
+         * @param backlog frames waiting for a worker at most, further frames are dropped
+         * @note Call before binding sources
+        */
+        rabbitmq_client& use_decode_pool(unsigned threads, std::size_t backlog);
+
+        bool validate_json(boost::property_tree::ptree ptree, source_options& src);
+        auto source_from_json(std::string s) -> std::optional<source_options>;
 
     private:
         AMQP::MessageCallback available_src_msg_callback(detection_service_visitor<cv::Mat>* visitor);
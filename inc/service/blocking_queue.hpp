@@ -0,0 +1,58 @@
+#pragma once
+
+#ifndef BLOCKING_QUEUE_HPP
+#define BLOCKING_QUEUE_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+/**
+ * @brief FIFO handing work over between pipeline stages, consumers block while it is empty.
+ * @note Unbounded by itself - a pipeline bounds it by the fixed number of jobs it circulates
+*/
+template <typename T>
+class blocking_queue
+{
+    private:
+        mutable std::mutex mutex;
+        std::condition_variable not_empty;
+        std::deque<T> items;
+
+    public:
+        blocking_queue() = default;
+        blocking_queue(const blocking_queue&) = delete;
+        void operator=(const blocking_queue&) = delete;
+
+        void push(T item)
+        {
+            {
+                std::lock_guard lock(mutex);
+                items.push_back(std::move(item));
+            }
+
+            not_empty.notify_one();
+        }
+
+        /**
+         * @brief Blocks until an item is available
+        */
+        T pop()
+        {
+            std::unique_lock lock(mutex);
+            not_empty.wait(lock, [this]() { return !items.empty(); });
+
+            T item = std::move(items.front());
+            items.pop_front();
+
+            return item;
+        }
+
+        std::size_t size() const
+        {
+            std::lock_guard lock(mutex);
+            return items.size();
+        }
+};
+
+#endif // BLOCKING_QUEUE_HPP
@@ -0,0 +1,149 @@
+#pragma once
+
+#ifndef DECODE_POOL_HPP
+#define DECODE_POOL_HPP
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include <opencv2/opencv.hpp>
+
+#include "task_pool.hpp"
+
+struct decode_stats
+{
+    unsigned long long decoded{0};
+
+    /**
+     * Frames decoded at 1/2, 1/4 or 1/8 of their resolution
+    */
+    unsigned long long reduced{0};
+
+    /**
+     * Frames turned away because every worker was busy and the backlog (or the share of their source) was full
+    */
+    unsigned long long rejected{0};
+
+    std::size_t pending{0};
+};
+
+/**
+ * @brief Decodes compressed frames (JPEG, PNG...) on a bounded pool of workers, off the message bus thread.
+ * @brief Frames of a source are delivered in arrival order, one at a time, whichever worker finished them.
+ * @brief Frames much larger than the model input are decoded at a reduced scale (IMREAD_REDUCED_COLOR_2/4/8).
+*/
+class decode_pool
+{
+    public:
+        /**
+         * @param frame decoded frame
+         * @param scale source pixels per frame pixel, boxes found on the frame are multiplied by it
+        */
+        using deliver_callback = std::function<void(std::shared_ptr<cv::Mat> frame, float scale)>;
+
+    private:
+        struct ready
+        {
+            std::shared_ptr<cv::Mat> frame{};
+            float scale{1.0f};
+            deliver_callback deliver{};
+        };
+
+        /**
+         * Delivery order of a single source
+        */
+        struct stream
+        {
+            std::mutex mutex{};
+            unsigned long long next_ticket{0};
+            unsigned long long next_delivery{0};
+            std::map<unsigned long long, ready> finished{};
+
+            // frames of the source waiting for or being decoded
+            std::atomic<std::size_t> pending{0};
+        };
+
+        /**
+         * Place of a submitted frame in the order of its source. A ticket that was never completed (the task threw
+         * or never ran) is completed empty when the claim goes away, later frames of the source are not held up by it.
+        */
+        struct claim
+        {
+            decode_pool* pool{nullptr};
+            std::shared_ptr<stream> source{};
+            unsigned long long ticket{0};
+            bool completed{false};
+
+            claim(decode_pool* pool, std::shared_ptr<stream> source, unsigned long long ticket);
+            ~claim();
+
+            void complete(ready next);
+        };
+
+        const std::size_t capacity;
+
+        std::mutex streams_mutex{};
+        std::unordered_map<unsigned, std::shared_ptr<stream>> streams{};
+        std::atomic<std::size_t> stream_count{0};
+
+        std::atomic<std::size_t> pending{0};
+        std::atomic<unsigned long long> decoded{0};
+        std::atomic<unsigned long long> reduced{0};
+        std::atomic<unsigned long long> rejected{0};
+
+        // last member - its workers are joined before the streams go away
+        task_pool workers;
+
+        std::shared_ptr<stream> stream_of(unsigned source_id);
+        unsigned long long take_ticket(stream& source);
+        void complete(stream& source, unsigned long long ticket, ready next);
+
+    public:
+        /**
+         * @param threads decode workers (at least one)
+         * @param backlog frames waiting for a worker at most, a source takes at most its share of it while other sources are active
+        */
+        decode_pool(unsigned threads, std::size_t backlog);
+
+        decode_pool(const decode_pool&) = delete;
+        void operator=(const decode_pool&) = delete;
+
+        /**
+         * @param payload encoded image, owned by the pool from now on
+         * @param target input shape of the model the frame is shrunk to (empty - decode at full resolution)
+         * @returns false when the backlog (or the share of the source) is full, the frame is dropped
+        */
+        bool submit(unsigned source_id, std::shared_ptr<cv::Mat> payload, cv::Size target, deliver_callback deliver);
+
+        /**
+         * @brief Delivers an already decoded (raw) frame in order with the compressed frames of the source.
+         * @brief Right away on the calling thread unless earlier frames of the source are still being decoded.
+        */
+        void deliver(unsigned source_id, std::shared_ptr<cv::Mat> frame, deliver_callback deliver);
+
+        /**
+         * @brief Drops the delivery order of an unregistered source, frames still being decoded are delivered all the same
+        */
+        void forget(unsigned source_id);
+
+        decode_stats get_stats() const;
+
+        unsigned size() const { return workers.size(); }
+
+        /**
+         * @brief Reads the dimensions of a PNG or JPEG image from its header
+         * @returns false for other formats
+        */
+        static bool read_image_size(const unsigned char* data, std::size_t size, cv::Size& image);
+
+        /**
+         * @returns largest reduction (1, 2, 4 or 8) that still leaves the image at least as large as it is letterboxed into the target
+        */
+        static int reduction_for(cv::Size image, cv::Size target);
+};
+
+#endif // DECODE_POOL_HPP
@@ -3,12 +3,32 @@
 #ifndef DETECTION_SERVICE_H
 #define DETECTION_SERVICE_H
 
+#include <array>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
 #include <thread>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <opencv2/opencv.hpp>
 
 #include "../ai/detection_model.hpp"
 #include "background_service.hpp"
+#include "blocking_queue.hpp"
+#include "frame_admission.hpp"
+#include "frame_trace.hpp"
+#include "motion_gate.hpp"
+#include "object_tracker.hpp"
+#include "result_cache.hpp"
+#include "result_info.hpp"
+#include "source_options.hpp"
+#include "spsc_ring.hpp"
+#include "task_pool.hpp"
+#include "work_signal.hpp"
 
 template <typename T>
 class detection_service_visitor;
@@ -22,14 +42,256 @@ class prioritize_load_strategy;
 template <typename T>
 class prioritize_order_strategy;
 
+template <typename T>
+class earliest_deadline_strategy;
+
+template <typename T>
+class weighted_fair_strategy;
+
 typedef basic_detection_service<cv::Mat> detection_service;
 
+using frame_clock = std::chrono::steady_clock;
+
+/**
+ * @brief Frame waiting for inference
+*/
+template <typename T>
+struct queued_frame
+{
+    std::shared_ptr<T> frame{};
+
+    /**
+     * Capture time when the producer stamps it, enqueue time otherwise
+    */
+    frame_clock::time_point origin{};
+
+    frame_trace trace{};
+
+    /**
+     * Keyframe of a tracked source (every frame of other sources), frames in between only advance the tracker
+    */
+    bool detect = true;
+
+    frame_key key{};
+
+    /**
+     * Source pixels per frame pixel of frames decoded at a reduced scale
+    */
+    float scale = 1.0f;
+
+    /**
+     * Detections known without inference (result cache, motion gate), the frame only keeps its place in the order of the source
+    */
+    std::shared_ptr<const cached_result> answer{};
+    result_info info{};
+};
+
+/**
+ * @brief Frames of a single source. Filled by one ingest thread at a time (the decode pool keeps them in order), drained by the replicas (serialised by the scheduler and the consumer lock of the lane).
+*/
+template <typename T>
+struct source_lane
+{
+    source_lane(const source_options& opts, std::size_t capacity, std::size_t model_group = 0) 
+        : id(opts.id), options(opts), group(model_group), frames(capacity), admission(opts.keep_every, opts.target_fps), weight(std::max(1u, opts.weight))
+    {
+        if(opts.motion_threshold > 0.0f)
+            motion = std::make_unique<motion_gate>(opts.motion_threshold, opts.max_reuse_age);
+
+        if(opts.tracking)
+            tracker = std::make_unique<object_tracker>();
+
+        if(opts.cache_size > 0)
+            cache = std::make_unique<result_cache>(opts.cache_size, opts.near_duplicate_distance);
+    }
+
+    const unsigned id;
+    const source_options options;
+
+    /**
+     * Index of the model group scheduling this source
+    */
+    const std::size_t group;
+
+    spsc_ring<queued_frame<T>> frames;
+
+    /**
+     * Serialises the consumer side of `frames`: the gathering replica and the ingest thread evicting the oldest frame on overflow
+    */
+    std::mutex consumer_mutex{};
+
+    // ingest thread only
+    frame_admission admission;
+
+    /**
+     * Change detector of the source, null when every frame is analysed
+    */
+    std::unique_ptr<motion_gate> motion{};
+
+    /**
+     * Tracker of the source, null when tracking is off. Driven by the thread publishing the frames of the source.
+    */
+    std::unique_ptr<object_tracker> tracker{};
+
+    // producer side, one ingest thread at a time
+    unsigned since_keyframe = 0;
+
+    /**
+     * Detections of recently analysed frames, null when caching is off
+    */
+    std::unique_ptr<result_cache> cache{};
+
+    std::atomic<unsigned long long> dropped{0};
+    std::atomic<unsigned long long> expired{0};
+    std::atomic<unsigned long long> skipped{0};
+    std::atomic<unsigned long long> served{0};
+    std::atomic<unsigned long long> carried_over{0};
+    std::atomic<unsigned long long> predicted{0};
+
+    std::atomic<unsigned> weight;
+
+    /**
+     * Input resolution the frames of the source are analysed at (0 - full, higher - cheaper), set by the resolution controller
+    */
+    std::atomic<std::size_t> level{0};
+
+    /**
+     * Set by a strategy that stopped looking at the lane because it was empty, cleared by the next enqueued frame
+    */
+    std::atomic<bool> parked{true};
+
+    /**
+     * @returns whether a frame of this source is past its staleness budget
+    */
+    bool is_expired(frame_clock::time_point origin, frame_clock::time_point now) const {
+        return options.staleness_budget.count() > 0 && now - origin > options.staleness_budget;
+    }
+};
+
+template <typename T>
+using source_table = std::map<unsigned, std::shared_ptr<source_lane<T>>>;
+
+/**
+ * @brief Configured versus achieved share of the analysed frames of a source
+*/
+struct source_share
+{
+    unsigned id{0};
+    unsigned weight{0};
+    double configured{0};
+    double achieved{0};
+    unsigned long long frames{0};
+};
+
+/**
+ * @brief Result cache hit rate of a source
+*/
+struct source_cache_stats
+{
+    unsigned id{0};
+    unsigned long long lookups{0};
+    unsigned long long hits{0};
+    double hit_rate{0};
+};
+
+/**
+ * @brief Stages a batch goes through. Preprocess, postprocess and publish run on the shared task pool, forward on the replica's own thread.
+*/
+enum class pipeline_stage
+{
+    preprocess,
+    forward,
+    postprocess,
+    publish
+};
+
+constexpr std::size_t pipeline_stage_count = 4;
+
+inline const char* to_string(pipeline_stage stage)
+{
+    switch(stage)
+    {
+        case pipeline_stage::preprocess: return "preprocess";
+        case pipeline_stage::forward: return "forward";
+        case pipeline_stage::postprocess: return "postprocess";
+        default: return "publish";
+    }
+}
+
+struct stage_report
+{
+    pipeline_stage stage{pipeline_stage::preprocess};
+
+    /**
+     * Batches waiting for the stage right now
+    */
+    long long depth{0};
+
+    /**
+     * Share of the stage's threads time spent working on it since the service started
+    */
+    double utilisation{0};
+
+    double avg_ms{0};
+    unsigned long long jobs{0};
+};
+
 struct performance_metrics
 {
     const double avgProcessingTime{0};
     const double avgFPS{0};
     const unsigned sourcesCount{0};
     const unsigned long long totalFramesProcessed{0}; 
+
+    /**
+     * Share of time replicas spent blocked waiting for frames
+    */
+    const double idleRatio{0};
+
+    /**
+     * Mean time between a frame being posted and a blocked replica waking up
+    */
+    const double avgWakeUpMicros{0};
+
+    /**
+     * Frames dropped unprocessed because they were past the staleness budget of their source
+    */
+    const unsigned long long expiredFrames{0};
+
+    /**
+     * Frames not admitted by the sampling policy of their source
+    */
+    const unsigned long long skippedFrames{0};
+
+    /**
+     * Frames dropped because the queue of their source was full
+    */
+    const unsigned long long droppedFrames{0};
+
+    /**
+     * Frames of unchanged scenes answered with the last detections of their source
+    */
+    const unsigned long long carriedOverFrames{0};
+
+    /**
+     * Frames of tracked sources answered with the boxes predicted by the tracker
+    */
+    const unsigned long long predictedFrames{0};
+
+    /**
+     * Frames answered from the result cache of their source
+    */
+    const unsigned long long cachedFrames{0};
+
+    /**
+     * Frames analysed below the full input resolution of their model
+    */
+    const unsigned long long degradedFrames{0};
+
+    /**
+     * Sources currently stepped down to a cheaper input resolution
+    */
+    const unsigned degradedSources{0};
 };
 
 // SaS Singleton as Service
@@ -37,7 +299,6 @@ template <typename T>
 class basic_detection_service : public background_service, public detection_service_visitor<T>
 {
     using class_ref = basic_detection_service<T>&;
-    using frame_queue = std::queue<std::shared_ptr<T>>;
 
     public:
         template <typename T2 = T>
@@ -46,24 +307,205 @@ class basic_detection_service : public background_service, public detection_serv
                 processing_order_strategy() = default;
                 virtual ~processing_order_strategy() = default;
 
-                virtual unsigned choose_next_queue(std::map<unsigned, frame_queue>& q, unsigned current_queue_id) = 0;
+                /**
+                 * @param sources snapshot of the source table
+                 * @param current_queue_id source chosen last time
+                 * @param busy sources being processed by another replica, their frames cannot be taken now
+                 * @returns source to take the next frame from
+                */
+                virtual unsigned choose_next_queue(const source_table<T2>& sources, unsigned current_queue_id, const std::unordered_set<unsigned>& busy) = 0;
+
+                /**
+                 * @brief Called by an ingest thread after a frame was enqueued, without holding the schedule lock
+                 * @note Frames of different sources may be enqueued concurrently by several decode workers
+                */
+                virtual void frame_enqueued(source_lane<T2>& /*lane*/) {}
         };
 
         friend class processing_order_strategy<T>;
 
+        /**
+         * Creates the strategy of every model group
+        */
+        using strategy_factory = std::function<std::unique_ptr<processing_order_strategy<T>>()>;
+
     private:
         const std::chrono::seconds sleep_on_empty{1};
         const unsigned max_size_per_que = 30;
-        std::map<unsigned, frame_queue> queues{};
-        std::map<unsigned, std::mutex> que_mutexes{};
-        std::map<unsigned, long long> dropped_frames{};
-        unsigned long long total_dropped_frames{0};
-        unsigned long long total_frames_processed{0};
-        cv::TickMeter performance_meter{};
+        std::atomic<unsigned long long> total_expired_frames{0};
+        std::atomic<unsigned long long> total_skipped_frames{0};
+        std::atomic<unsigned long long> total_overflow_frames{0};
+        std::atomic<unsigned long long> total_carried_over_frames{0};
+        std::atomic<unsigned long long> total_predicted_frames{0};
+        std::atomic<unsigned long long> total_cached_frames{0};
+        std::atomic<unsigned long long> total_degraded_frames{0};
+
+        // resolution controller: a source steps one level at a time, at most once per interval per model
+        const std::chrono::milliseconds adaptation_interval{500};
+        const unsigned relaxed_checks_to_step_up = 4;
+        std::chrono::milliseconds degrade_latency{200};
+
+        // copy-on-write tables of sources: readers work on a snapshot taken with atomic_load,
+        // writers publish a modified copy with atomic_store; a lane lives as long as any snapshot holds it
+        // `sources` holds every lane, each model group holds the lanes it schedules
+        std::mutex sources_mutex{};
+        std::shared_ptr<const source_table<T>> sources = std::make_shared<const source_table<T>>();
+        std::atomic<unsigned long long> total_frames_processed{0};
+
+        struct replica_metrics
+        {
+            // end-to-end time of a batch, from gathering to publishing
+            double latency_ms{0};
+
+            // time spent in forward passes
+            double busy_ms{0};
+            double idle_ms{0};
+            unsigned long long batches{0};
+            unsigned long long frames{0};
+            unsigned long long wake_ups{0};
+            unsigned long long wake_up_us{0};
+        };
+
+        std::mutex metrics_mutex{};
+        std::vector<replica_metrics> performance_meters{};
+
+        struct flight
+        {
+            std::size_t replica{0};
+            unsigned frames{0};
+        };
+
+        /**
+         * Replicas of one registered model together with the sources they serve, scheduled and batched on their own
+        */
+        struct model_group
+        {
+            std::string name{};
+
+            // indices of the replicas in `models`
+            std::vector<std::size_t> replicas{};
+
+            std::shared_ptr<const source_table<T>> sources = std::make_shared<const source_table<T>>();
 
-        std::mutex inference_mutex{};
-        std::unique_ptr<detection_model> model{};
-        std::unique_ptr<processing_order_strategy<T>> strategy = std::unique_ptr<processing_order_strategy<T>>(new prioritize_order_strategy<T>());
+            // serialises the consumers of the lanes, guards strategy and in-flight sources; inference runs outside of it
+            std::mutex schedule_mutex{};
+            unsigned current_queue_id = 0;
+            std::unique_ptr<processing_order_strategy<T>> strategy{};
+
+            // sources with frames somewhere in a pipeline, other replicas leave them alone to keep their frames in order
+            std::unordered_map<unsigned, flight> in_flight_sources{};
+
+            // producers post enqueued frames, replicas block on it when there is nothing to take
+            work_signal work{};
+
+            // input shapes every replica of the model can run, the full one first
+            std::vector<cv::Size> resolutions{};
+
+            // resolution controller state, guarded by schedule_mutex
+            frame_clock::time_point next_adaptation{};
+            unsigned long long seen_dropped{0};
+            unsigned relaxed_checks{0};
+        };
+
+        // registry order, the first group is the default model
+        std::vector<std::unique_ptr<model_group>> groups{};
+
+        strategy_factory make_strategy = []() { return std::unique_ptr<processing_order_strategy<T>>(new prioritize_order_strategy<T>()); };
+
+        struct replica_pipeline;
+
+        /**
+         * Batch travelling through the stages of one replica
+        */
+        struct pipeline_job
+        {
+            replica_pipeline* pipeline{nullptr};
+
+            // buffers of every resolution level, a batch runs at a single level
+            std::vector<std::unique_ptr<inference_job>> inferences{};
+            std::size_t level{0};
+            detection_model* model{nullptr};
+            inference_job* inference{nullptr};
+
+            std::vector<unsigned> sources{};
+            std::vector<std::shared_ptr<T>> frames{};
+            std::vector<frame_trace> traces{};
+            std::vector<frame_key> keys{};
+            std::vector<float> scales{};
+
+            // detections of frames answered without inference, null for the others
+            std::vector<std::shared_ptr<const cached_result>> answers{};
+            std::vector<result_info> infos{};
+
+            // model input slots, a frame of a tiled source takes a slot per tile
+            std::vector<T> batch{};
+            std::vector<cv::Rect> regions{};
+
+            // slots taken by every frame: 0 - tracked only, 1 - whole frame, more - tiles
+            std::vector<std::size_t> slots{};
+
+            // results of frames not answered straight from a slot (tiled or tracked only)
+            std::vector<std::vector<detection>> merged{};
+
+            // stages shared by every frame of the batch
+            frame_trace timeline{};
+
+            unsigned long long sequence{0};
+            bool failed{false};
+            frame_clock::time_point gathered{};
+            unsigned long long growth_events{0};
+        };
+
+        struct replica_pipeline
+        {
+            std::size_t index{0};
+            detection_model* model{nullptr};
+
+            // model of every resolution level of the group, the full one first
+            std::vector<detection_model*> levels{};
+
+            model_group* group{nullptr};
+            std::vector<std::unique_ptr<pipeline_job>> jobs{};
+
+            // jobs free to gather into, their fixed number bounds every queue of the pipeline
+            blocking_queue<pipeline_job*> free_jobs{};
+            blocking_queue<pipeline_job*> forward_queue{};
+
+            // gathering thread only
+            unsigned long long next_sequence{0};
+            std::unordered_set<unsigned> blocked{};
+
+            // jobs that finished out of order wait for the ones gathered before them
+            std::mutex publish_mutex{};
+            std::map<unsigned long long, pipeline_job*> finished{};
+            unsigned long long next_publish{0};
+        };
+
+        struct stage_meter
+        {
+            std::atomic<long long> depth{0};
+            std::atomic<unsigned long long> busy_us{0};
+            std::atomic<unsigned long long> jobs{0};
+        };
+
+        unsigned pipeline_threads = 0;
+        unsigned pipeline_depth = 3;
+        std::atomic<unsigned> pool_workers{0};
+        std::unique_ptr<task_pool> pool{};
+        std::vector<std::unique_ptr<replica_pipeline>> pipelines{};
+        std::array<stage_meter, pipeline_stage_count> stages{};
+        const frame_clock::time_point started = frame_clock::now();
+
+        int threads_per_replica = 0;
+        std::vector<std::unique_ptr<detection_model>> models{};
+
+        // cheaper variants of every replica in `models`, largest input first
+        std::vector<std::vector<std::unique_ptr<detection_model>>> degraded_models{};
+
+        /**
+         * @returns index of the group registered under the name, the default group for an empty name
+        */
+        std::optional<std::size_t> find_group(const std::string& name) const;
 
     protected:
         basic_detection_service() = default;
@@ -79,12 +521,93 @@ class basic_detection_service : public background_service, public detection_serv
         void use_model(std::unique_ptr<detection_model>& ptr);
         void use_model(std::unique_ptr<detection_model>&& ptr);
 
+        /**
+         * @brief Adds another model replica. Each replica runs inference on its own thread.
+         * @note Replicas have to be added before the service is started
+        */
+        void add_replica(std::unique_ptr<detection_model>& ptr);
+        void add_replica(std::unique_ptr<detection_model>&& ptr);
+
+        /**
+         * @brief Adds a replica of a named model, the first replica of a name registers the model.
+         * @brief Sources name the model in their registration, every model batches and schedules its sources on its own.
+         * @note The first registered model is the default one
+        */
+        void add_replica(const std::string& model, std::unique_ptr<detection_model>&& ptr);
+
+        /**
+         * @brief Adds a replica of a named model compiled at several input resolutions
+         * @param resolutions the model at full resolution followed by its variants in decreasing resolution
+        */
+        void add_replica(const std::string& model, std::vector<std::unique_ptr<detection_model>>&& resolutions);
+
+        /**
+         * @returns names of the registered models, the default one first
+        */
+        std::vector<std::string> get_model_names() const;
+
+        /**
+         * @brief Sets the number of OpenCV threads used by every replica thread (0 - OpenCV default)
+         * @note With OpenMP/TBB parallel backends the limit applies per replica thread; the pthreads backend shares one pool
+        */
+        void set_threads_per_replica(int threads);
+
+        /**
+         * @param threads workers of the task pool running preprocess, postprocess and publish (0 - half of the hardware threads)
+         * @param depth batches in flight per replica, 3 lets preprocess, forward and postprocess of consecutive batches overlap
+         * @note Has to be set before the service is started
+        */
+        void set_pipeline(unsigned threads, unsigned depth);
+
+        /**
+         * @param latency_target queueing delay above which sources of models with degraded variants step down a resolution
+        */
+        void set_resolution_control(std::chrono::milliseconds latency_target);
+
         bool register_source(const unsigned source_id);
+        bool register_source(const source_options& options);
         bool unregister_source(const unsigned source_id);
 
+        /**
+         * @brief Replaces the order in which sources are served, every model group gets its own strategy from the factory
+         * @note Has to be set before frames start arriving, the ingest thread notifies the strategy without the schedule lock
+        */
+        void use_strategy(strategy_factory factory);
+
         performance_metrics get_performance();
 
-        bool try_add_to_queue(const unsigned source_id, std::shared_ptr<T> frame);
+        /**
+         * @returns configured and achieved share of every source
+        */
+        std::vector<source_share> get_source_shares();
+
+        /**
+         * @returns result cache hit rate of every source with a cache
+        */
+        std::vector<source_cache_stats> get_cache_stats();
+
+        /**
+         * @returns queue depth and utilisation of every pipeline stage
+        */
+        std::vector<stage_report> get_stage_metrics();
+
+        /**
+         * @param origin capture time of the frame if known, its staleness is measured from it
+         * @param trace timeline of the frame so far (ingest, decode)
+        */
+        bool try_add_to_queue(const unsigned source_id, std::shared_ptr<T> frame, frame_clock::time_point origin = frame_clock::now(), frame_trace trace = {}, std::uint64_t content = 0, float scale = 1.0f);
+
+        /**
+         * @brief Queues the detections of a frame answered without inference, they are published in order with the other frames of the source
+         * @param frame decoded frame, null when the frame was answered before decoding
+        */
+        bool try_add_answer(const unsigned source_id, std::shared_ptr<T> frame, std::shared_ptr<const cached_result> answer, result_info info, frame_clock::time_point origin, frame_trace trace);
+
+        /**
+         * @brief Applies the admission policy of the source to its next frame
+         * @returns false when the frame should be skipped
+        */
+        bool admit_frame(const unsigned source_id);
         bool add_to_queue(const unsigned source_id, std::shared_ptr<T> frame);
 
         virtual std::thread run_background_service() override;
@@ -94,18 +617,63 @@ class basic_detection_service : public background_service, public detection_serv
     private:
         virtual void run() override;
 
+        /**
+         * @brief Pushes a frame to its lane, applies the overflow policy of the source when the lane is full
+        */
+        bool enqueue(source_lane<T>& lane, queued_frame<T> queued);
+
+        /**
+         * @brief Gathering loop of a single model replica, hands batches over to the preprocess stage
+         * @param replica index of the replica in the pool
+        */
+        void run_replica(std::size_t replica);
+
+        /**
+         * @brief Forward loop of a single model replica, runs on its dedicated thread
+        */
+        void run_forward(std::size_t replica);
+
+        /**
+         * @brief Takes frames from the lanes into a job
+         * @returns false when there was nothing runnable
+        */
+        bool gather(replica_pipeline& pipeline, pipeline_job& job);
+
+        /**
+         * @brief Steps the sources of a priority class a resolution down when the queues of the group back up, or up when the load dropped
+         * @note Called with the schedule lock of the group held
+        */
+        void adapt_resolution(model_group& group, const source_table<T>& lanes, std::size_t batch_size, frame_clock::time_point now);
+
+        void run_preprocess(pipeline_job& job);
+        void run_postprocess(pipeline_job& job);
+
+        /**
+         * @brief Publishes the job once every job gathered before it on the replica is published
+        */
+        void finish(pipeline_job& job);
+        void publish(pipeline_job& job);
+
+        void record_stage(pipeline_stage stage, double ms);
+
         // Visitor
     public:
-        virtual bool visit_new_src(unsigned src_id) override;
+        virtual bool visit_new_src(const source_options& options) override;
         virtual bool visit_obsolete_src(unsigned src_id) override;
-        virtual bool visit_new_frame(unsigned src_id, std::shared_ptr<T> frame) override;
+        virtual bool visit_frame_age(unsigned src_id, std::chrono::milliseconds age) override;
+        virtual bool visit_frame_admission(unsigned src_id) override;
+        virtual bool visit_cache_enabled(unsigned src_id) override;
+        virtual std::shared_ptr<const cached_result> visit_frame_content(unsigned src_id, std::uint64_t content) override;
+        virtual bool visit_cached_frame(unsigned src_id, std::shared_ptr<const cached_result> answer, frame_clock::time_point origin, const frame_trace& trace) override;
+        virtual cv::Size visit_decode_target(unsigned src_id) override;
+        virtual bool visit_new_frame(unsigned src_id, std::shared_ptr<T> frame, frame_clock::time_point origin, const frame_trace& trace, std::uint64_t content = 0, float scale = 1.0f) override;
 };
 
 template <typename T>
 class prioritize_load_strategy : public basic_detection_service<T>::processing_order_strategy<T>
 {
     public:
-        virtual unsigned choose_next_queue(std::map<unsigned, std::queue<std::shared_ptr<T>>>& q, unsigned current_queue_id) override;
+        virtual unsigned choose_next_queue(const source_table<T>& sources, unsigned current_queue_id, const std::unordered_set<unsigned>& busy) override;
 };
 
 template <typename T>
@@ -114,7 +682,60 @@ class prioritize_order_strategy : public basic_detection_service<T>::processing_
     public:
         prioritize_order_strategy() = default;
         virtual ~prioritize_order_strategy() = default;
-        virtual unsigned choose_next_queue(std::map<unsigned, std::queue<std::shared_ptr<T>>>& q, unsigned current_queue_id) override;
+        virtual unsigned choose_next_queue(const source_table<T>& sources, unsigned current_queue_id, const std::unordered_set<unsigned>& busy) override;
+};
+
+/**
+ * @brief Serves the source whose oldest frame is closest to its deadline (origin + staleness budget) first
+ * @note Sources without a budget are ordered as if they had default_budget
+*/
+template <typename T>
+class earliest_deadline_strategy : public basic_detection_service<T>::processing_order_strategy<T>
+{
+    private:
+        const std::chrono::milliseconds default_budget{1000};
+
+    public:
+        earliest_deadline_strategy() = default;
+        virtual ~earliest_deadline_strategy() = default;
+        virtual unsigned choose_next_queue(const source_table<T>& sources, unsigned current_queue_id, const std::unordered_set<unsigned>& busy) override;
+};
+
+/**
+ * @brief Stride scheduling: every source advances its pass by a stride inversely proportional to its weight,
+ * @brief the runnable source with the lowest pass is served next. Picks cost O(log n) in the number of active sources.
+ * @note Empty sources are parked (taken out of the index) and come back when a frame is enqueued,
+ * @note they resume at the current virtual time so idle periods do not bank credit
+*/
+template <typename T>
+class weighted_fair_strategy : public basic_detection_service<T>::processing_order_strategy<T>
+{
+    private:
+        static constexpr unsigned long long stride_base = 1ull << 20;
+
+        struct entry
+        {
+            unsigned long long pass{0};
+            bool active{false};
+        };
+
+        // (pass, source id) of the active sources, guarded by the schedule lock
+        std::set<std::pair<unsigned long long, unsigned>> active{};
+        std::unordered_map<unsigned, entry> entries{};
+        unsigned long long virtual_time{0};
+
+        // sources unparked by the ingest thread since the last pick
+        std::mutex woken_mutex{};
+        std::vector<unsigned> woken{};
+        std::vector<unsigned> waking{};
+
+        void activate(unsigned id);
+
+    public:
+        weighted_fair_strategy() = default;
+        virtual ~weighted_fair_strategy() = default;
+        virtual unsigned choose_next_queue(const source_table<T>& sources, unsigned current_queue_id, const std::unordered_set<unsigned>& busy) override;
+        virtual void frame_enqueued(source_lane<T>& lane) override;
 };
 
 template <typename T = cv::Mat>
@@ -124,9 +745,50 @@ class detection_service_visitor
         detection_service_visitor() = default;
         virtual ~detection_service_visitor() = default;
 
-        virtual bool visit_new_src(unsigned src_id) = 0;
+        virtual bool visit_new_src(const source_options& options) = 0;
         virtual bool visit_obsolete_src(unsigned src_id) = 0;
-        virtual bool visit_new_frame(unsigned src_id, std::shared_ptr<T> frame) = 0;
+
+        /**
+         * @brief Checked before decoding a frame stamped with its capture time
+         * @returns false when the frame is already too old to be worth decoding
+        */
+        virtual bool visit_frame_age(unsigned src_id, std::chrono::milliseconds age) = 0;
+
+        /**
+         * @brief Checked before decoding every frame
+         * @returns false when the sampling policy of the source skips the frame
+        */
+        virtual bool visit_frame_admission(unsigned src_id) = 0;
+
+        /**
+         * @returns true when the source keeps a result cache, the frame bytes are only hashed for those
+        */
+        virtual bool visit_cache_enabled(unsigned src_id) = 0;
+
+        /**
+         * @brief Checked before decoding every admitted frame of a source with a result cache
+         * @param content hash of the frame bytes
+         * @returns detections of an identical frame from the result cache of the source, null when the frame has to be decoded
+        */
+        virtual std::shared_ptr<const cached_result> visit_frame_content(unsigned src_id, std::uint64_t content) = 0;
+
+        /**
+         * @brief Hands over a frame answered by visit_frame_content, its detections are published in order with the other frames of the source
+         * @note Called in the order the frames of the source arrived, like visit_new_frame
+        */
+        virtual bool visit_cached_frame(unsigned src_id, std::shared_ptr<const cached_result> answer, std::chrono::steady_clock::time_point origin, const frame_trace& trace) = 0;
+
+        /**
+         * @returns input shape of the model serving the source, compressed frames may be decoded down to it (empty - full resolution needed)
+        */
+        virtual cv::Size visit_decode_target(unsigned src_id) = 0;
+
+        /**
+         * @param content hash of the frame bytes (0 - not hashed)
+         * @param scale source pixels per frame pixel when the frame was decoded at a reduced scale
+         * @note Called by one thread at a time per source, in the order the frames of the source arrived
+        */
+        virtual bool visit_new_frame(unsigned src_id, std::shared_ptr<T> frame, std::chrono::steady_clock::time_point origin, const frame_trace& trace, std::uint64_t content = 0, float scale = 1.0f) = 0;
 };
 
 #endif // DETECTION_SERVICE_H
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+
+#ifndef FRAME_ADMISSION_HPP
+#define FRAME_ADMISSION_HPP
+
+#include <algorithm>
+#include <chrono>
+
+/**
+ * @brief Decides which frames of a source are worth analysing (keep-every-Nth sampling and a target FPS token bucket).
+ * @note Not thread-safe, used by the single ingest thread of the source only
+*/
+class frame_admission
+{
+    using clock = std::chrono::steady_clock;
+
+    private:
+        const unsigned keep_every;
+        const double target_fps;
+
+        // the bucket holds at most one token, a late frame does not earn a burst of frames afterwards
+        const double bucket_size = 1.0;
+
+        unsigned long long frames_seen = 0;
+        double tokens = 1.0;
+        clock::time_point last_refill{};
+
+    public:
+        /**
+         * @param every keep every N-th frame (0 or 1 - keep all)
+         * @param fps max frames per second let through (0 - no limit)
+        */
+        frame_admission(unsigned every, double fps) : keep_every(std::max(1u, every)), target_fps(std::max(0.0, fps)) {}
+
+        /**
+         * @returns whether the next frame of the source should be analysed
+        */
+        bool admit(clock::time_point now = clock::now())
+        {
+            if(frames_seen++ % keep_every != 0)
+                return false;
+
+            if(target_fps <= 0.0)
+                return true;
+
+            if(last_refill != clock::time_point{})
+            {
+                const std::chrono::duration<double> elapsed = now - last_refill;
+                tokens = std::min(bucket_size, tokens + elapsed.count() * target_fps);
+            }
+
+            last_refill = now;
+
+            if(tokens < 1.0)
+                return false;
+
+            tokens -= 1.0;
+            return true;
+        }
+};
+
+#endif // FRAME_ADMISSION_HPP
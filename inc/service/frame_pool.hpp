@@ -0,0 +1,121 @@
+#pragma once
+
+#ifndef FRAME_POOL_HPP
+#define FRAME_POOL_HPP
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+struct frame_pool_options
+{
+    /**
+     * Memory the pool keeps at most, released slabs above it go back to the system
+    */
+    std::size_t max_bytes = std::size_t(512) << 20;
+
+    /**
+     * Frames of that shape and type preallocated at startup (0 - none, slabs are allocated on first use)
+    */
+    unsigned preallocate_frames = 0;
+    cv::Size preallocate_shape{1920, 1080};
+    int preallocate_type = CV_8UC3;
+
+    /**
+     * Back slabs with huge pages (explicit when reserved, transparent otherwise) - fewer TLB misses over large frames
+    */
+    bool huge_pages = false;
+};
+
+/**
+ * @brief Occupancy of a single size class
+*/
+struct frame_pool_stats
+{
+    std::size_t slab_bytes{0};
+    std::size_t slabs{0};
+    std::size_t in_use{0};
+    std::size_t high_water{0};
+    unsigned long long acquired{0};
+
+    /**
+     * Slabs that had to be allocated, flat once the pool is warm
+    */
+    unsigned long long allocations{0};
+};
+
+/**
+ * @brief Owned buffers for incoming frames, recycled in power-of-two size classes.
+ * @brief A frame holds its slab until the last shared_ptr to it is released (queues, processing, publishers),
+ * @brief so steady-state ingest costs one memcpy per frame and no frame-sized allocation.
+*/
+class frame_pool
+{
+    private:
+        struct slab
+        {
+            unsigned char* data{nullptr};
+
+            // size class, the allocation itself may be rounded up to whole huge pages
+            std::size_t size{0};
+            std::size_t bytes{0};
+            bool mapped{false};
+        };
+
+        struct size_class
+        {
+            std::vector<slab> free{};
+            frame_pool_stats stats{};
+        };
+
+        /**
+         * Outlives the pool as long as any frame holds a slab
+        */
+        struct pool_state
+        {
+            std::mutex mutex{};
+            frame_pool_options options{};
+            std::map<std::size_t, size_class> classes{};
+            std::size_t owned_bytes{0};
+
+            ~pool_state();
+
+            slab allocate(std::size_t bytes) const;
+            void free(const slab& buffer) const;
+            void release(const slab& buffer);
+        };
+
+        std::shared_ptr<pool_state> state = std::make_shared<pool_state>();
+
+        frame_pool() = default;
+
+        static std::size_t class_of(std::size_t bytes);
+
+    public:
+        frame_pool(const frame_pool&) = delete;
+        void operator=(const frame_pool&) = delete;
+
+        static frame_pool& get_instance();
+
+        /**
+         * @brief Applies the options and preallocates the configured frames
+         * @note Call once at startup, before frames arrive
+        */
+        void configure(const frame_pool_options& options);
+
+        /**
+         * @returns frame over a pooled slab, its contents are undefined
+        */
+        std::shared_ptr<cv::Mat> acquire(int rows, int cols, int type);
+
+        /**
+         * @returns occupancy of every size class in use
+        */
+        std::vector<frame_pool_stats> get_stats();
+};
+
+#endif // FRAME_POOL_HPP
@@ -0,0 +1,98 @@
+#pragma once
+
+#ifndef FRAME_TRACE_HPP
+#define FRAME_TRACE_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * @brief Steps a frame goes through from the camera to the published result
+*/
+enum class trace_stage
+{
+    transport,      // capture (producer timestamp) -> received from the broker
+    ingest,         // received -> decode starts (headers, admission)
+    decode,
+    queue_wait,     // enqueued -> gathered into a batch
+    preprocess,
+    forward,
+    postprocess,    // decoding and NMS
+    result_queue,   // handed to the processing service -> picked up
+    serialize,
+    publish
+};
+
+constexpr std::size_t trace_stage_count = 10;
+
+inline const char* to_string(trace_stage stage)
+{
+    switch(stage)
+    {
+        case trace_stage::transport: return "transport";
+        case trace_stage::ingest: return "ingest";
+        case trace_stage::decode: return "decode";
+        case trace_stage::queue_wait: return "queue_wait";
+        case trace_stage::preprocess: return "preprocess";
+        case trace_stage::forward: return "forward";
+        case trace_stage::postprocess: return "postprocess";
+        case trace_stage::result_queue: return "result_queue";
+        case trace_stage::serialize: return "serialize";
+        default: return "publish";
+    }
+}
+
+/**
+ * @brief Timeline of a single frame, travels with the frame by value
+*/
+struct frame_trace
+{
+    using clock = std::chrono::steady_clock;
+
+    unsigned source_id = 0;
+    unsigned long long frame_id = 0;
+
+    /**
+     * Capture timestamp of the producer (ms since epoch), 0 when the frame was not stamped
+    */
+    std::int64_t captured_ms = 0;
+
+    std::array<clock::time_point, trace_stage_count> begin{};
+    std::array<clock::time_point, trace_stage_count> end{};
+
+    void start(trace_stage stage, clock::time_point at = clock::now()) { begin[index(stage)] = at; }
+    void stop(trace_stage stage, clock::time_point at = clock::now()) { end[index(stage)] = at; }
+
+    void span(trace_stage stage, clock::time_point from, clock::time_point to)
+    {
+        begin[index(stage)] = from;
+        end[index(stage)] = to;
+    }
+
+    /**
+     * @brief Copies a stage shared by the whole batch (e.g. forward) from the batch timeline
+    */
+    void copy(trace_stage stage, const frame_trace& other)
+    {
+        begin[index(stage)] = other.begin[index(stage)];
+        end[index(stage)] = other.end[index(stage)];
+    }
+
+    bool has(trace_stage stage) const
+    {
+        return begin[index(stage)] != clock::time_point{} && end[index(stage)] >= begin[index(stage)];
+    }
+
+    std::chrono::microseconds duration(trace_stage stage) const
+    {
+        if(!has(stage))
+            return std::chrono::microseconds(0);
+
+        return std::chrono::duration_cast<std::chrono::microseconds>(end[index(stage)] - begin[index(stage)]);
+    }
+
+    static constexpr std::size_t index(trace_stage stage) { return static_cast<std::size_t>(stage); }
+};
+
+#endif // FRAME_TRACE_HPP
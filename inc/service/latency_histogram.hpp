@@ -0,0 +1,98 @@
+#pragma once
+
+#ifndef LATENCY_HISTOGRAM_HPP
+#define LATENCY_HISTOGRAM_HPP
+
+#include <array>
+#include <cstdint>
+
+/**
+ * @brief HDR-style log-linear histogram of latencies in microseconds.
+ * @brief Values below 64us are exact, above that every power of two is split into 32 linear sub-buckets (~3% error),
+ * @brief so recording is O(1) and tail percentiles stay accurate over the whole 64-bit range in fixed memory.
+ * @note Not thread-safe
+*/
+class latency_histogram
+{
+    static constexpr unsigned sub_bucket_bits = 5;
+    static constexpr std::uint64_t sub_buckets = 1ull << sub_bucket_bits;
+    static constexpr std::uint64_t exact_limit = sub_buckets * 2;
+    static constexpr std::size_t bucket_count = exact_limit + (64 - sub_bucket_bits - 1) * sub_buckets;
+
+    private:
+        std::array<std::uint64_t, bucket_count> counts{};
+        std::uint64_t total = 0;
+        std::uint64_t max_value = 0;
+
+        static unsigned msb(std::uint64_t value)
+        {
+            unsigned bit = 0;
+            while(value >>= 1)
+                ++bit;
+            return bit;
+        }
+
+        static std::size_t index_of(std::uint64_t value)
+        {
+            if(value < exact_limit)
+                return static_cast<std::size_t>(value);
+
+            // value >> shift lands in [sub_buckets, 2 * sub_buckets)
+            const unsigned shift = msb(value) - sub_bucket_bits;
+            const std::uint64_t sub = (value >> shift) - sub_buckets;
+
+            return static_cast<std::size_t>(exact_limit + (shift - 1) * sub_buckets + sub);
+        }
+
+        /**
+         * @returns highest value that falls into the bucket
+        */
+        static std::uint64_t value_of(std::size_t index)
+        {
+            if(index < exact_limit)
+                return index;
+
+            const unsigned shift = static_cast<unsigned>((index - exact_limit) / sub_buckets) + 1;
+            const std::uint64_t sub = (index - exact_limit) % sub_buckets + sub_buckets;
+
+            return ((sub + 1) << shift) - 1;
+        }
+
+    public:
+        void record(std::uint64_t value)
+        {
+            counts[index_of(value)]++;
+            total++;
+
+            if(value > max_value)
+                max_value = value;
+        }
+
+        /**
+         * @param quantile e.g. 0.99
+         * @returns value not exceeded by the given share of the recorded values (0 when empty)
+        */
+        std::uint64_t percentile(double quantile) const
+        {
+            if(total == 0)
+                return 0;
+
+            const auto target = static_cast<std::uint64_t>(quantile * total + 0.5);
+            std::uint64_t seen = 0;
+
+            for(std::size_t i = 0; i < bucket_count; i++)
+            {
+                seen += counts[i];
+
+                if(seen >= target && seen > 0)
+                    return value_of(i) < max_value ? value_of(i) : max_value;
+            }
+
+            return max_value;
+        }
+
+        std::uint64_t count() const { return total; }
+        std::uint64_t max() const { return max_value; }
+};
+
+#endif // LATENCY_HISTOGRAM_HPP
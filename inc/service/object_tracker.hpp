@@ -0,0 +1,92 @@
+#pragma once
+
+#ifndef OBJECT_TRACKER_HPP
+#define OBJECT_TRACKER_HPP
+
+#include <atomic>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/video/tracking.hpp>
+
+#include "../ai/detection_model.hpp"
+
+struct tracker_options
+{
+    /**
+     * Minimum IoU of a detection with the predicted box of a track to continue the track
+    */
+    float iou_threshold = 0.3f;
+
+    /**
+     * Frames a track is predicted without a matching detection before it is dropped
+    */
+    unsigned max_age = 15;
+
+    /**
+     * Confidence of a predicted box is multiplied by it on every frame without a detection
+    */
+    float confidence_decay = 0.95f;
+
+    /**
+     * Once the mean confidence of the tracks falls below it the next frame is sent to the detector
+    */
+    float min_confidence = 0.3f;
+};
+
+/**
+ * @brief SORT-style multi-object tracker of a single source.
+ * @brief Keyframes go through the detector and update the tracks (greedy IoU association, constant velocity Kalman filter),
+ * @brief frames in between are answered with the predicted boxes. Every box carries the id of its track.
+ * @note Not thread-safe - frames of a source are published in order by one thread at a time
+*/
+class object_tracker
+{
+    private:
+        struct track
+        {
+            int id = 0;
+            int class_id = 0;
+            float confidence = 0.0f;
+            unsigned since_update = 0;
+            cv::KalmanFilter filter{};
+            cv::Rect2f predicted{};
+        };
+
+        const tracker_options options;
+
+        std::vector<track> tracks{};
+        int next_id = 1;
+
+        // set by the publishing thread, read by the ingest thread
+        std::atomic<bool> detection_wanted{true};
+
+        // association scratch
+        std::vector<bool> matched_tracks{};
+        std::vector<bool> matched_detections{};
+
+        track create_track(const detection& det);
+        void advance(track& t);
+
+    public:
+        object_tracker(const tracker_options& opts = {});
+
+        /**
+         * @brief Advances the tracks to a keyframe and corrects them with its detections
+         * @param detections [in, out] detections of the keyframe, track ids are filled in
+        */
+        void update(std::vector<detection>& detections);
+
+        /**
+         * @brief Advances the tracks to a frame that was not sent to the detector
+         * @param predicted [out] predicted box of every live track
+        */
+        void predict(std::vector<detection>& predicted);
+
+        /**
+         * @returns whether the tracks lost too much confidence (or there are none yet) and the next frame should be a keyframe
+        */
+        bool wants_detection() const { return detection_wanted.load(std::memory_order_relaxed); }
+};
+
+#endif // OBJECT_TRACKER_HPP
@@ -11,6 +11,8 @@
 #include <opencv2/opencv.hpp>
 
 #include "background_service.hpp"
+#include "frame_trace.hpp"
+#include "result_info.hpp"
 #include "../ai/detection_model.hpp"
 #include "../publisher/data_publisher.hpp"
 #include "../publisher/img_publisher.hpp"
@@ -32,7 +34,7 @@ class basic_processing_service : public background_service
         std::map<unsigned, float> thresholds;
         std::set<unsigned> excluded;
         std::vector<std::string> labels;
-        std::queue< std::tuple<unsigned, std::shared_ptr<T>, std::vector<detection>> > results;
+        std::queue< std::tuple<unsigned, std::shared_ptr<T>, std::vector<detection>, std::shared_ptr<const class_table>, frame_trace, result_info> > results;
         std::mutex sync;
 
         std::shared_ptr<data_publisher> json_publisher;
@@ -45,8 +47,9 @@ class basic_processing_service : public background_service
          * @brief Applies results in place.
          * @param img image
          * @param results detections
+         * @param classes labels and colors of the model that produced the detections
         */
-        void apply_results(std::shared_ptr<T> img, const std::vector<detection>& results);
+        void apply_results(std::shared_ptr<T> img, const std::vector<detection>& results, const class_table& classes);
 
         virtual void run() override;
 
@@ -60,7 +63,7 @@ class basic_processing_service : public background_service
         self_ptr set_data_publisher(std::shared_ptr<data_publisher> publisher);
         self_ptr set_img_publisher(std::shared_ptr<img_publisher> publisher);
         
-        void push_results(unsigned src_id, std::shared_ptr<T> frame, const std::vector<detection>& detections);
+        void push_results(unsigned src_id, std::shared_ptr<T> frame, const std::vector<detection>& detections, std::shared_ptr<const class_table> classes, frame_trace trace = {}, result_info info = {});
 
         static self_ptr get_service_instance();
 
@@ -0,0 +1,105 @@
+#pragma once
+
+#ifndef RESULT_CACHE_HPP
+#define RESULT_CACHE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "../ai/detection_model.hpp"
+
+/**
+ * @brief Identity of a frame in the result cache
+*/
+struct frame_key
+{
+    // hash of the frame bytes as received (0 - not hashed)
+    std::uint64_t content = 0;
+
+    // difference hash of the decoded frame, near-duplicates differ in a few bits
+    std::uint64_t perceptual = 0;
+    bool has_perceptual = false;
+};
+
+/**
+ * @brief Cached detections of a frame
+*/
+struct cached_result
+{
+    std::vector<detection> detections{};
+    std::shared_ptr<const class_table> classes{};
+};
+
+/**
+ * @brief Per-source LRU cache of detections of recently analysed frames.
+ * @brief Identical frames (frozen cameras, republished frames) are found by the hash of their bytes before decoding,
+ * @brief near-duplicates by the perceptual hash of the decoded frame.
+*/
+class result_cache
+{
+    private:
+        struct entry
+        {
+            frame_key key{};
+            cached_result result{};
+        };
+
+        const std::size_t capacity;
+        const unsigned max_distance;
+
+        std::mutex mutex{};
+
+        // most recently used first
+        std::list<entry> entries{};
+        std::unordered_map<std::uint64_t, std::list<entry>::iterator> by_content{};
+
+        std::atomic<unsigned long long> hits{0};
+        std::atomic<unsigned long long> lookups{0};
+
+        std::optional<cached_result> hit(std::list<entry>::iterator it);
+
+    public:
+        /**
+         * @param capacity frames remembered
+         * @param max_distance differing bits of the perceptual hashes up to which frames count as duplicates
+        */
+        result_cache(std::size_t capacity, unsigned max_distance = 0);
+
+        /**
+         * @brief Fast 64-bit hash of the frame bytes (XXH64)
+        */
+        static std::uint64_t hash_bytes(const void* data, std::size_t size);
+
+        /**
+         * @brief Difference hash: a 9x8 grayscale thumbnail, one bit per horizontal neighbour comparison
+        */
+        static std::uint64_t perceptual_hash(const cv::Mat& frame);
+
+        /**
+         * @returns detections of a frame with the same bytes
+        */
+        std::optional<cached_result> find_content(std::uint64_t content);
+
+        /**
+         * @returns detections of the most recently used frame with a perceptual hash within max_distance
+        */
+        std::optional<cached_result> find_similar(std::uint64_t perceptual);
+
+        /**
+         * @brief Remembers the detections of an analysed frame, evicts the least recently used frame when full
+        */
+        void store(const frame_key& key, const std::vector<detection>& detections, const std::shared_ptr<const class_table>& classes);
+
+        unsigned long long get_hits() const { return hits; }
+        unsigned long long get_lookups() const { return lookups; }
+};
+
+#endif // RESULT_CACHE_HPP
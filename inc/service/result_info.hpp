@@ -0,0 +1,40 @@
+#pragma once
+
+#ifndef RESULT_INFO_HPP
+#define RESULT_INFO_HPP
+
+#include <cstdint>
+
+/**
+ * @brief How a published result was produced, sent along as message headers
+*/
+struct result_info
+{
+    /**
+     * Detections of an earlier analysed frame reused because the scene did not change
+    */
+    bool carried_over = false;
+
+    /**
+     * Age of the reused detections in ms
+    */
+    std::int64_t result_age_ms = 0;
+
+    /**
+     * Boxes predicted by the tracker of the source, the frame did not go through the detector
+    */
+    bool predicted = false;
+
+    /**
+     * Detections of an identical or near-duplicate frame taken from the result cache of the source
+    */
+    bool cached = false;
+
+    /**
+     * Input resolution of the network that analysed the frame (0 - not analysed)
+    */
+    int input_width = 0;
+    int input_height = 0;
+};
+
+#endif // RESULT_INFO_HPP
@@ -0,0 +1,109 @@
+#pragma once
+
+#ifndef SOURCE_OPTIONS_HPP
+#define SOURCE_OPTIONS_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief What to do with a new frame when the queue of its source is full
+*/
+enum class overflow_policy
+{
+    drop_newest,    // keep the queued frames, reject the new one
+    drop_oldest     // evict the oldest queued frame, keeps the analysis close to live
+};
+
+/**
+ * @brief Source settings carried by the registration message
+*/
+struct source_options
+{
+    unsigned id = 0;
+    std::string exchange{};
+
+    /**
+     * Max age of a frame before it is dropped unprocessed (0 - no limit).
+     * Age counts from capture when the producer stamps frames with the "captured" header, otherwise from enqueueing.
+    */
+    std::chrono::milliseconds staleness_budget{0};
+
+    overflow_policy on_overflow = overflow_policy::drop_newest;
+
+    /**
+     * Analyse every N-th frame only (1 - every frame)
+    */
+    unsigned keep_every = 1;
+
+    /**
+     * Max analysed frames per second, excess frames are skipped before decoding (0 - no limit)
+    */
+    double target_fps = 0.0;
+
+    /**
+     * Relative share of inference time under the fair-share strategy, re-registering a known source updates it
+    */
+    unsigned weight = 1;
+
+    /**
+     * Name of the registered model analysing the source (empty - the default model)
+    */
+    std::string model{};
+
+    /**
+     * Cut frames into overlapping model-sized tiles batched through the model together, for small objects in high-resolution feeds.
+     * A frame costs as many batch slots as it has tiles, tiles grow when they would not fit the batch size of the model.
+    */
+    bool tiled = false;
+
+    /**
+     * Minimum overlap of neighbouring tiles as a fraction of the tile size
+    */
+    float tile_overlap = 0.2f;
+
+    /**
+     * Run the whole (downscaled) frame as an extra tile, catches objects larger than a tile
+    */
+    bool global_view = true;
+
+    /**
+     * Mean absolute difference (gray levels) of a tiny thumbnail up to which a frame counts as unchanged,
+     * unchanged frames are not analysed and the last detections are published again (0 - every frame is analysed)
+    */
+    float motion_threshold = 0.0f;
+
+    /**
+     * Detections are reused for at most that long, then the scene is analysed again
+    */
+    std::chrono::milliseconds max_reuse_age{1000};
+
+    /**
+     * Track objects across frames, published detections carry the id of their track
+    */
+    bool tracking = false;
+
+    /**
+     * With tracking only every N-th frame goes through the detector, the tracker predicts the boxes of the frames in between.
+     * A keyframe comes earlier when the confidence of the tracks decays.
+    */
+    unsigned detect_every = 1;
+
+    /**
+     * Detections of that many recently analysed frames are remembered, identical and near-duplicate frames reuse them (0 - no cache)
+    */
+    std::size_t cache_size = 0;
+
+    /**
+     * Differing bits of the perceptual hashes (out of 64) up to which a decoded frame counts as a duplicate
+    */
+    unsigned near_duplicate_distance = 0;
+
+    /**
+     * Under overload sources of lower priority step down to a cheaper input resolution first and come back up last
+    */
+    unsigned priority = 0;
+};
+
+#endif // SOURCE_OPTIONS_HPP
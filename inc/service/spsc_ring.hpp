@@ -0,0 +1,103 @@
+#pragma once
+
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief Fixed-capacity single-producer/single-consumer ring buffer.
+ * @brief Push and pop are wait-free; head and tail live on separate cache lines so the two sides do not false-share.
+ * @note Exactly one thread may push and one thread (or callers serialised by a lock) may pop at a time
+*/
+template <typename T>
+class spsc_ring
+{
+    static constexpr std::size_t cache_line = 64;
+
+    private:
+        // next slot to read, written by the consumer only
+        alignas(cache_line) std::atomic<std::size_t> head{0};
+
+        // next slot to write, written by the producer only
+        alignas(cache_line) std::atomic<std::size_t> tail{0};
+
+        // one slot always stays free to tell a full ring from an empty one
+        alignas(cache_line) std::vector<T> slots;
+
+        std::size_t next(std::size_t index) const { return ++index == slots.size() ? 0 : index; }
+
+    public:
+        explicit spsc_ring(std::size_t capacity) : slots(capacity + 1) {}
+
+        spsc_ring(const spsc_ring&) = delete;
+        void operator=(const spsc_ring&) = delete;
+
+        /**
+         * @brief Producer side
+         * @returns false when the ring is full (the value is left untouched)
+        */
+        bool try_push(T& value)
+        {
+            const auto t = tail.load(std::memory_order_relaxed);
+            const auto n = next(t);
+
+            if(n == head.load(std::memory_order_acquire))
+                return false;
+
+            slots[t] = std::move(value);
+            tail.store(n, std::memory_order_release);
+
+            return true;
+        }
+
+        /**
+         * @brief Consumer side
+         * @returns false when the ring is empty
+        */
+        bool try_pop(T& value)
+        {
+            const auto h = head.load(std::memory_order_relaxed);
+
+            if(h == tail.load(std::memory_order_acquire))
+                return false;
+
+            value = std::move(slots[h]);
+            slots[h] = T{}; // do not keep the element alive in the slot
+            head.store(next(h), std::memory_order_release);
+
+            return true;
+        }
+
+        /**
+         * @brief Consumer side
+         * @returns oldest element, nullptr when the ring is empty; valid until it is popped
+        */
+        T* front()
+        {
+            const auto h = head.load(std::memory_order_relaxed);
+
+            if(h == tail.load(std::memory_order_acquire))
+                return nullptr;
+
+            return &slots[h];
+        }
+
+        /**
+         * @returns number of elements, exact only on the producer or consumer thread
+        */
+        std::size_t size() const
+        {
+            const auto t = tail.load(std::memory_order_acquire);
+            const auto h = head.load(std::memory_order_acquire);
+
+            return t >= h ? t - h : t + slots.size() - h;
+        }
+
+        bool empty() const { return size() == 0; }
+        std::size_t capacity() const { return slots.size() - 1; }
+};
+
+#endif // SPSC_RING_HPP
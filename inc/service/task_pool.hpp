@@ -0,0 +1,64 @@
+#pragma once
+
+#ifndef TASK_POOL_HPP
+#define TASK_POOL_HPP
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "work_signal.hpp"
+
+/**
+ * @brief Work-stealing thread pool shared by the CPU-bound pipeline stages.
+ * @brief Every worker owns a deque: it takes its own newest task first (cache-warm),
+ * @brief idle workers steal the oldest tasks of the others.
+ * @note Keep task captures small (a couple of pointers) so std::function does not allocate
+*/
+class task_pool
+{
+    public:
+        using task = std::function<void()>;
+
+    private:
+        struct worker_queue
+        {
+            std::mutex mutex;
+            std::deque<task> tasks;
+        };
+
+        std::vector<std::unique_ptr<worker_queue>> queues{};
+        std::vector<std::thread> workers{};
+
+        // tasks submitted from outside the pool are spread round robin
+        std::atomic<std::size_t> next_queue{0};
+        std::atomic<bool> stopping{false};
+
+        work_signal work{};
+
+        bool try_take(std::size_t self, task& next);
+        void run_worker(std::size_t self);
+
+    public:
+        /**
+         * @param threads number of workers (at least one)
+        */
+        explicit task_pool(unsigned threads);
+        ~task_pool();
+
+        task_pool(const task_pool&) = delete;
+        void operator=(const task_pool&) = delete;
+
+        /**
+         * @brief Queues a task, a worker submitting a follow-up keeps it on its own deque
+        */
+        void submit(task next);
+
+        unsigned size() const { return static_cast<unsigned>(workers.size()); }
+};
+
+#endif // TASK_POOL_HPP
@@ -0,0 +1,86 @@
+#pragma once
+
+#ifndef TRACE_RECORDER_HPP
+#define TRACE_RECORDER_HPP
+
+#include <array>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "frame_trace.hpp"
+#include "latency_histogram.hpp"
+
+/**
+ * @brief Latency percentiles of a single stage in microseconds
+*/
+struct stage_latency
+{
+    std::string stage{};
+    unsigned long long count{0};
+    unsigned long long p50{0};
+    unsigned long long p99{0};
+    unsigned long long p999{0};
+    unsigned long long max{0};
+};
+
+/**
+ * @brief Collects finished frame traces: per-stage latency histograms of every frame,
+ * @brief plus the full timeline of sampled frames exported as Chrome trace-event JSON (chrome://tracing, Perfetto)
+*/
+class trace_recorder
+{
+    private:
+        std::mutex mutex{};
+
+        // serialises the exports, the periodic one and a manual one could otherwise write the same file at once
+        std::mutex export_mutex{};
+
+        std::array<latency_histogram, trace_stage_count> stages{};
+
+        // capture (or receive when not stamped) -> published
+        latency_histogram end_to_end{};
+
+        unsigned sample_every = 0;
+        std::size_t max_samples = 1000;
+        std::size_t samples_since_export = 0;
+        std::string trace_path{};
+        unsigned long long traces_seen = 0;
+        std::deque<frame_trace> samples{};
+
+        const frame_trace::clock::time_point epoch = frame_trace::clock::now();
+
+        trace_recorder() = default;
+
+        void write_chrome_trace(const std::string& path, const std::deque<frame_trace>& traces);
+
+    public:
+        trace_recorder(const trace_recorder&) = delete;
+        void operator=(const trace_recorder&) = delete;
+
+        static trace_recorder& get_instance();
+
+        /**
+         * @param every keep the timeline of every N-th frame (0 - no sampling)
+         * @param path file the sampled timelines are written to, rewritten with the latest window every 100 samples
+        */
+        void set_sampling(unsigned every, const std::string& path);
+
+        /**
+         * @brief Records a frame once its result was published
+        */
+        void record(const frame_trace& trace);
+
+        /**
+         * @returns p50/p99/p999 of every stage followed by the end-to-end latency
+        */
+        std::vector<stage_latency> get_latencies();
+
+        /**
+         * @brief Writes the currently held sampled timelines as Chrome trace-event JSON
+        */
+        void export_chrome_trace(const std::string& path);
+};
+
+#endif // TRACE_RECORDER_HPP
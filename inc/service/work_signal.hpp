@@ -0,0 +1,101 @@
+#pragma once
+
+#ifndef WORK_SIGNAL_HPP
+#define WORK_SIGNAL_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+/**
+ * @brief Counting wake-up primitive between frame producers and inference workers.
+ * @brief Producers post the frames they enqueue, workers block while there is nothing new to look at.
+ * @note Every change bumps a version, a worker that found nothing runnable waits for the version to move on,
+ * @note so frames it cannot take (e.g. their source is busy on another replica) do not make it spin.
+*/
+class work_signal
+{
+    using clock = std::chrono::steady_clock;
+
+    private:
+        std::mutex mutex;
+        std::condition_variable changed;
+
+        unsigned long long pending = 0;
+        unsigned long long version = 0;
+        clock::time_point last_change{};
+
+    public:
+        work_signal() = default;
+        ~work_signal() = default;
+        work_signal(const work_signal&) = delete;
+        void operator=(const work_signal&) = delete;
+
+        /**
+         * @brief Announces newly enqueued frames and wakes a worker
+        */
+        void post(unsigned long long count = 1)
+        {
+            {
+                std::lock_guard lock(mutex);
+                pending += count;
+                ++version;
+                last_change = clock::now();
+            }
+
+            changed.notify_one();
+        }
+
+        /**
+         * @brief Marks frames as taken (or dropped) by a worker
+        */
+        void consume(unsigned long long count)
+        {
+            std::lock_guard lock(mutex);
+            pending -= count < pending ? count : pending;
+        }
+
+        /**
+         * @brief Wakes every worker without adding work (e.g. a source became schedulable again)
+        */
+        void release()
+        {
+            {
+                std::lock_guard lock(mutex);
+                ++version;
+                last_change = clock::now();
+            }
+
+            changed.notify_all();
+        }
+
+        /**
+         * @returns current version, read it before looking for work
+        */
+        unsigned long long current_version()
+        {
+            std::lock_guard lock(mutex);
+            return version;
+        }
+
+        /**
+         * @brief Blocks until frames are pending and something changed since `seen_version`
+         * @param seen_version version read before the worker last looked for work
+         * @returns time between the change that woke the worker and the wake-up (zero when the wait did not block)
+        */
+        std::chrono::microseconds wait(unsigned long long seen_version)
+        {
+            std::unique_lock lock(mutex);
+
+            const auto runnable = [&]() { return pending > 0 && version != seen_version; };
+
+            if(runnable())
+                return std::chrono::microseconds(0);
+
+            changed.wait(lock, runnable);
+
+            return std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - last_change);
+        }
+};
+
+#endif // WORK_SIGNAL_HPP
@@ -5,6 +5,8 @@
 #include <memory>
 #include <optional>
 #include <thread>
+#include <chrono>
+#include <cstdlib>
 
 // OpenCV
 #include <opencv2/opencv.hpp>
@@ -37,8 +39,12 @@
 #include "inc/utils.hpp"
 #include "inc/ai/yolo_v8.hpp"
 #include "inc/ai/yolo_v5.hpp"
+#include "inc/ai/precision_report.hpp"
+#include "inc/ai/model_registry.hpp"
 #include "inc/service/background_service.hpp"
+#include "inc/service/frame_pool.hpp"
 #include "inc/service/processing_service.hpp"
+#include "inc/service/trace_recorder.hpp"
 #include "inc/publisher/data_publisher.hpp"
 #include "inc/publisher/img_publisher.hpp"
 #include "inc/defaults.hpp"
@@ -61,7 +67,32 @@ int main(int argc, const char** argv)
         ("type",    boost::program_options::value<std::string>()->default_value("v8"), "AI model type e.g. v8, v5. Default: v8")
         ("shape",   boost::program_options::value<std::string>()->default_value("640x640"), "model shape (Width x Height) e.g. 640x640. Default: 640x640")
         ("path",    boost::program_options::value<std::string>(), "path to resources (models)")
-        ("model",   boost::program_options::value<std::string>()->default_value("yolov8n.onnx"), "model name e.g. yolov8n.onnx. Default: yolov8n.onnx");
+        ("model",   boost::program_options::value<std::string>()->default_value("yolov8n.onnx"), "model name e.g. yolov8n.onnx. Default: yolov8n.onnx")
+        ("models",  boost::program_options::value<std::string>(), "JSON file listing several named models to serve, sources pick one by name (overrides --model, --type, --shape, --replicas)")
+        ("batch",   boost::program_options::value<unsigned>()->default_value(1), "max number of frames per forward pass. Default: 1")
+        ("fixed-batch", boost::program_options::bool_switch()->default_value(false), "model was exported with a static batch size equal to --batch")
+        ("backend", boost::program_options::value<std::string>()->default_value("cuda"), "inference backend e.g. cuda, cpu, opencl. Default: cuda")
+        ("replicas", boost::program_options::value<unsigned>()->default_value(1), "number of model replicas running inference concurrently. Default: 1")
+        ("decode-threads", boost::program_options::value<unsigned>()->default_value(0), "threads decoding compressed frames (0 - a quarter of the hardware threads, at least 2). Default: 0")
+        ("decode-backlog", boost::program_options::value<unsigned>()->default_value(0), "compressed frames waiting for a decode thread before new ones are dropped (0 - 4 per thread). Default: 0")
+        ("degrade", boost::program_options::value<std::string>()->default_value(""), "cheaper model shapes sources step down to under load e.g. 480x480,320x320 (empty - never degrade). Default: none")
+        ("frame-pool-mb", boost::program_options::value<unsigned>()->default_value(512), "memory kept for incoming frames in MB. Default: 512")
+        ("frame-pool-frames", boost::program_options::value<unsigned>()->default_value(0), "frames of --frame-pool-shape preallocated at startup. Default: 0")
+        ("frame-pool-shape", boost::program_options::value<std::string>()->default_value("1920x1080"), "shape of the preallocated frames (Width x Height, 3 channels). Default: 1920x1080")
+        ("huge-pages", boost::program_options::bool_switch()->default_value(false), "back the frame pool with huge pages")
+        ("degrade-latency", boost::program_options::value<unsigned>()->default_value(200), "queueing delay in ms above which sources step down a resolution. Default: 200")
+        ("threads", boost::program_options::value<int>()->default_value(0), "OpenCV threads per replica (0 - OpenCV default). Default: 0")
+        ("pipeline-threads", boost::program_options::value<unsigned>()->default_value(0), "threads preprocessing and postprocessing batches, shared by the replicas (0 - half of the hardware threads). Default: 0")
+        ("pipeline-depth", boost::program_options::value<unsigned>()->default_value(3), "batches in flight per replica, lets preprocess, forward and postprocess overlap. Default: 3")
+        ("trace-sample", boost::program_options::value<unsigned>()->default_value(0), "keep the full timeline of every N-th frame (0 - off). Default: 0")
+        ("trace-file", boost::program_options::value<std::string>()->default_value("frame_trace.json"), "Chrome trace-event file the sampled timelines are written to. Default: frame_trace.json")
+        ("strategy", boost::program_options::value<std::string>()->default_value("order"), "order in which sources are served e.g. order, load, deadline, fair. Default: order")
+        ("class-aware-nms", boost::program_options::bool_switch()->default_value(false), "suppress overlapping boxes only within the same class")
+        ("nms-top-k", boost::program_options::value<unsigned>()->default_value(0), "best scoring candidates per frame passed to NMS (0 - all). Default: 0")
+        ("max-detections", boost::program_options::value<unsigned>()->default_value(0), "max detections per frame (0 - no limit). Default: 0")
+        ("warm-up-passes", boost::program_options::value<unsigned>()->default_value(10), "max warm-up passes per batch size (0 - no warm-up). Default: 10")
+        ("precision", boost::program_options::value<std::string>()->default_value("fp32"), "inference precision e.g. fp32, fp16, int8 (loads <model>_int8.onnx). Default: fp32")
+        ("compare-precision", boost::program_options::value<std::string>(), "run the images of a local folder in every precision, report speed and deviation from fp32, then exit");
 
     desc.print(std::cout);
 
@@ -129,12 +160,125 @@ int main(int argc, const char** argv)
         get_env_or_throw(env); 
     } else model = vm["model"].as<std::string>();
 
+    model_options options;
+    options.max_batch_size = std::max(1u, vm["batch"].as<unsigned>());
+    options.fixed_batch = vm["fixed-batch"].as<bool>();
+    options.class_aware_nms = vm["class-aware-nms"].as<bool>();
+    options.nms_top_k = vm["nms-top-k"].as<unsigned>();
+    options.max_detections = vm["max-detections"].as<unsigned>();
+
+    const std::string backend = vm["backend"].as<std::string>();
+
+    if(boost::iequals(backend, "cuda")) {
+        options.backend = cv::dnn::DNN_BACKEND_CUDA;
+        options.target = cv::dnn::DNN_TARGET_CUDA;
+    }
+    else if(boost::iequals(backend, "cpu")) {
+        options.backend = cv::dnn::DNN_BACKEND_OPENCV;
+        options.target = cv::dnn::DNN_TARGET_CPU;
+    }
+    else if(boost::iequals(backend, "opencl")) {
+        options.backend = cv::dnn::DNN_BACKEND_OPENCV;
+        options.target = cv::dnn::DNN_TARGET_OPENCL;
+    }
+    else {
+        spdlog::critical("Invalid backend {}", backend);
+        return -1;
+    }
+
+    const std::string precision = vm["precision"].as<std::string>();
+
+    if(boost::iequals(precision, "fp32"))
+        options.precision = precision_mode::fp32;
+    else if(boost::iequals(precision, "fp16"))
+        options.precision = precision_mode::fp16;
+    else if(boost::iequals(precision, "int8"))
+        options.precision = precision_mode::int8;
+    else {
+        spdlog::critical("Invalid precision {}", precision);
+        return -1;
+    }
+
+    const unsigned replicas = std::max(1u, vm["replicas"].as<unsigned>());
+    const int threads_per_replica = vm["threads"].as<int>();
+    const unsigned warm_up_passes = vm["warm-up-passes"].as<unsigned>();
+
     spdlog::info("Using spdlog version {}.{}.{}!", SPDLOG_VER_MAJOR, SPDLOG_VER_MINOR, SPDLOG_VER_PATCH);
     spdlog::info("Using OpenCV version {}", CV_VERSION);
     
     const std::string modelsPath = path;
-    const auto& model_name = model;
-    const cv::Size model_shape = size;
+
+    model_spec default_spec;
+    default_spec.type = type;
+    default_spec.file = model;
+    default_spec.shape = size;
+    default_spec.replicas = replicas;
+    default_spec.options = options;
+
+    try {
+        default_spec.degraded_shapes = parse_shapes(vm["degrade"].as<std::string>());
+    }
+    catch(const std::exception& e) {
+        spdlog::critical(e.what());
+        return -1;
+    }
+
+    const auto make_model = [&](const model_options& model_opts) -> std::unique_ptr<detection_model>
+    {
+        auto spec = default_spec;
+        spec.options = model_opts;
+
+        return create_model(spec, modelsPath);
+    };
+
+    std::vector<model_spec> model_specs;
+
+    try {
+        model_specs = vm.count("models")
+            ? load_model_specs(vm["models"].as<std::string>(), default_spec)
+            : std::vector<model_spec> { default_spec };
+    }
+    catch(const std::exception& e) {
+        spdlog::critical(e.what());
+        return -1;
+    }
+
+    if(vm.count("compare-precision"))
+    {
+        std::vector<cv::String> files;
+        cv::glob(vm["compare-precision"].as<std::string>(), files);
+
+        std::vector<cv::Mat> images;
+        for(const auto& file: files)
+        {
+            auto image = cv::imread(file, cv::IMREAD_COLOR);
+            if(!image.empty())
+                images.push_back(image);
+        }
+
+        spdlog::info("Comparing precisions on {} image(s)", images.size());
+
+        const auto reports = compare_precisions(make_model, options, images, { precision_mode::fp16, precision_mode::int8 });
+
+        for(const auto& report: reports)
+        {
+            spdlog::info(
+                "{} \t{:.2f}ms mean \t{:.2f}ms p50 \t{:.2f}ms p95 \t{:.2f} fps \tmatched {} missing {} extra {} \tIoU {:.3f} \tscore delta {:.4f} (max {:.4f})",
+                to_string(report.precision),
+                report.mean_ms,
+                report.p50_ms,
+                report.p95_ms,
+                report.fps,
+                report.matched,
+                report.missing,
+                report.extra,
+                report.mean_iou,
+                report.mean_score_delta,
+                report.max_score_delta);
+        }
+
+        return 0;
+    }
 
     #pragma region ENV
 
@@ -166,35 +310,95 @@ int main(int argc, const char** argv)
 
     #pragma region YOLO
 
-    const std::chrono::seconds gpu_warm_up_time(5);
+    auto& service = detection_service::get_service_instance();
 
-    std::unique_ptr<detection_model> model_ptr;
-    
-    if(boost::iequals(type, "v5")) {
-        model_ptr = std::make_unique<yolo_v5>(model_shape, modelsPath, model_name);
-        spdlog::info("Creating model v5");
+    spdlog::info("Batch size {} ({})", options.max_batch_size, options.fixed_batch ? "fixed" : "dynamic");
+    spdlog::info("{} model(s), {} OpenCV thread(s) per replica", model_specs.size(), threads_per_replica);
+
+    service.set_threads_per_replica(threads_per_replica);
+    service.set_pipeline(vm["pipeline-threads"].as<unsigned>(), vm["pipeline-depth"].as<unsigned>());
+    service.set_resolution_control(std::chrono::milliseconds(vm["degrade-latency"].as<unsigned>()));
+
+    frame_pool_options pool_options;
+    pool_options.max_bytes = static_cast<std::size_t>(vm["frame-pool-mb"].as<unsigned>()) << 20;
+    pool_options.preallocate_frames = vm["frame-pool-frames"].as<unsigned>();
+    pool_options.huge_pages = vm["huge-pages"].as<bool>();
+
+    try {
+        const auto pool_shapes = parse_shapes(vm["frame-pool-shape"].as<std::string>());
+
+        if(!pool_shapes.empty())
+            pool_options.preallocate_shape = pool_shapes.front();
+
+        frame_pool::get_instance().configure(pool_options);
     }
-    else {
-        model_ptr = std::make_unique<yolo_v8>(model_shape, modelsPath, model_name);
-        spdlog::info("Creating model v8");
+    catch(const std::exception& e) {
+        spdlog::critical("Could not set up the frame pool: {}", e.what());
+        return -1;
     }
+    trace_recorder::get_instance().set_sampling(vm["trace-sample"].as<unsigned>(), vm["trace-file"].as<std::string>());
 
-    auto& service = detection_service::get_service_instance();
-    service.use_model(model_ptr);
+    const auto strategy = vm["strategy"].as<std::string>();
 
-    background_services.emplace_back(service.run_background_service());
+    using order_strategy = std::unique_ptr<detection_service::processing_order_strategy<cv::Mat>>;
 
-    spdlog::info("Warming up GPU...");
-    service.register_source(0);
-    auto warmup_frame = std::shared_ptr<cv::Mat>(new cv::Mat(cv::Mat::zeros(model_shape, CV_8UC3)));
-    service.try_add_to_queue(0, warmup_frame);
+    // every model schedules its own sources, so each gets a strategy instance
+    if(boost::iequals(strategy, "fair"))
+        service.use_strategy([]() { return order_strategy(new weighted_fair_strategy<cv::Mat>()); });
+    else if(boost::iequals(strategy, "deadline"))
+        service.use_strategy([]() { return order_strategy(new earliest_deadline_strategy<cv::Mat>()); });
+    else if(boost::iequals(strategy, "load"))
+        service.use_strategy([]() { return order_strategy(new prioritize_load_strategy<cv::Mat>()); });
+    else if(!boost::iequals(strategy, "order")) {
+        spdlog::critical("Invalid strategy {}", strategy);
+        return -1;
+    }
 
-    // sleep this thread
-    // let background service warm up the GPU cache and connection
-    // so it won't clog up queues with pending frames from rabbitmq client
-    std::this_thread::sleep_for(gpu_warm_up_time);
-    
-    service.unregister_source(0);
+    spdlog::info("Serving sources in {} order", strategy);
+
+    const auto startup = std::chrono::steady_clock::now();
+
+    // load and warm up the replicas while the broker connection and topology are being set up
+    std::shared_future<void> models_ready = std::async(std::launch::async, [&]()
+    {
+        std::vector<std::pair<std::string, std::future<std::vector<std::unique_ptr<detection_model>>>>> loading;
+
+        for(const auto& spec: model_specs)
+        for(unsigned replica = 0; replica < spec.replicas; replica++)
+        {
+            loading.emplace_back(spec.name, std::async(std::launch::async, [&, replica]()
+            {
+                // the full resolution model followed by its degraded variants
+                auto variants = create_model_variants(spec, modelsPath);
+
+                if(warm_up_passes == 0)
+                    return variants;
+
+                for(const auto& variant: variants)
+                for(const auto& result: variant->warm_up(warm_up_passes))
+                {
+                    const auto input = variant->get_input_shape();
+
+                    spdlog::info(
+                        "Model '{}' ({}x{}) replica {} warm-up: batch {} \t{} passes \tfirst {:.2f}ms \tsteady {:.2f}ms{}",
+                        spec.name,
+                        input.width,
+                        input.height,
+                        replica,
+                        result.batch_size,
+                        result.passes,
+                        result.first_ms,
+                        result.stable_ms,
+                        result.stabilised ? "" : " (not stabilised)");
+                }
+
+                return variants;
+            }));
+        }
+
+        for(auto& [name, model]: loading)
+            service.add_replica(name, model.get());
+    }).share();
 
     #pragma endregion YOLO
 
@@ -212,9 +416,21 @@ int main(int argc, const char** argv)
     auto visitor = &service;
     auto rabbitmq = std::make_shared<rabbitmq_client>(available_sources_que, unregister_sources_que , amqp_host);
 
+    const unsigned decode_threads = vm["decode-threads"].as<unsigned>() > 0 
+        ? vm["decode-threads"].as<unsigned>() 
+        : std::max(2u, std::thread::hardware_concurrency() / 4);
+
+    const unsigned decode_backlog = vm["decode-backlog"].as<unsigned>() > 0 ? vm["decode-backlog"].as<unsigned>() : 4 * decode_threads;
+
+    rabbitmq->use_decode_pool(decode_threads, decode_backlog);
+
+    // declare right away, start consuming sources only once the model is warm
     rabbitmq->init_exchanges(exchanges)
-        .bind_available_sources(available_sources_exchange, visitor)
-        .bind_obsolete_sources(unregister_sources_exchange, visitor);
+        .when_ready(models_ready, [&]()
+        {
+            rabbitmq->bind_available_sources(available_sources_exchange, visitor)
+                .bind_obsolete_sources(unregister_sources_exchange, visitor);
+        });
 
     #pragma region PUBLISHER
 
@@ -235,6 +451,19 @@ int main(int argc, const char** argv)
     rabbitmq_clients.emplace_back( rabbitmq_publisher->client_run() );
     //rabbitmq_clients.emplace_back( rabbitmq_img_publisher->client_run() );
 
+    try {
+        models_ready.get();
+    }
+    catch(const std::exception& e) {
+        spdlog::critical("Could not load the model: {}", e.what());
+        std::quick_exit(-1);
+    }
+
+    const std::chrono::duration<double> ready_after = std::chrono::steady_clock::now() - startup;
+    spdlog::info("Model ready after {:.2f}s", ready_after.count());
+
+    background_services.emplace_back(service.run_background_service());
+
     for(auto& client: rabbitmq_clients)
         client.join();
 
@@ -0,0 +1,60 @@
+#include "../inc/ai/detection_model.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+std::vector<warm_up_result> detection_model::warm_up(unsigned max_passes, double tolerance)
+{
+    // number of consecutive passes that have to agree
+    constexpr std::size_t window = 3;
+
+    const unsigned max_batch = this->get_max_batch_size();
+
+    // a static batch dimension always runs at the max batch size
+    const unsigned smallest = this->options.fixed_batch ? max_batch : 1;
+
+    const cv::Mat frame(cv::Size(this->model_shape), CV_8UC3, cv::Scalar::all(114));
+
+    std::vector<cv::Mat> batch;
+    std::vector<std::vector<detection>> results;
+    std::vector<double> latencies;
+    std::vector<warm_up_result> report;
+
+    for(unsigned size = smallest; size <= max_batch; size++)
+    {
+        batch.assign(size, frame);
+        latencies.clear();
+
+        warm_up_result result;
+        result.batch_size = size;
+
+        while(result.passes < std::max(1u, max_passes))
+        {
+            cv::TickMeter meter;
+            meter.start();
+            this->object_detection_batch(batch, results);
+            meter.stop();
+
+            latencies.push_back(meter.getTimeMilli());
+            result.passes++;
+
+            if(latencies.size() < window)
+                continue;
+
+            const auto [fastest, slowest] = std::minmax_element(latencies.end() - window, latencies.end());
+
+            if(*slowest - *fastest <= *fastest * tolerance) {
+                result.stabilised = true;
+                break;
+            }
+        }
+
+        const std::size_t tail = std::min(window, latencies.size());
+        result.first_ms = latencies.front();
+        result.stable_ms = std::accumulate(latencies.end() - tail, latencies.end(), 0.0) / tail;
+
+        report.push_back(result);
+    }
+
+    return report;
+}
@@ -0,0 +1,147 @@
+#include "../inc/ai/model_registry.hpp"
+#include "../inc/ai/yolo_v5.hpp"
+#include "../inc/ai/yolo_v8.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <set>
+#include <stdexcept>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include <spdlog/spdlog.h>
+
+namespace
+{
+    cv::Size parse_shape(const std::string& shape)
+    {
+        const auto pos = shape.find("x");
+
+        if(pos == std::string::npos)
+            throw std::runtime_error("Invalid model shape " + shape);
+
+        const int width = std::atoi(shape.substr(0, pos).c_str());
+        const int height = std::atoi(shape.substr(pos + 1).c_str());
+
+        if(width <= 0 || height <= 0)
+            throw std::runtime_error("Invalid model shape " + shape);
+
+        return cv::Size(width, height);
+    }
+
+    precision_mode parse_precision(const std::string& precision)
+    {
+        if(boost::iequals(precision, "fp32"))
+            return precision_mode::fp32;
+        if(boost::iequals(precision, "fp16"))
+            return precision_mode::fp16;
+        if(boost::iequals(precision, "int8"))
+            return precision_mode::int8;
+
+        throw std::runtime_error("Invalid precision " + precision);
+    }
+}
+
+std::vector<model_spec> load_model_specs(const std::string& path, const model_spec& defaults)
+{
+    boost::property_tree::ptree root;
+
+    try {
+        boost::property_tree::read_json(path, root);
+    }
+    catch(const boost::property_tree::ptree_error& e) {
+        throw std::runtime_error("Could not read models config " + path + ": " + e.what());
+    }
+
+    std::vector<model_spec> specs;
+    std::set<std::string> names;
+
+    for(const auto& [key, entry]: root)
+    {
+        model_spec spec = defaults;
+
+        try {
+            spec.name = entry.get<std::string>("name");
+            spec.file = entry.get<std::string>("model");
+            spec.type = entry.get<std::string>("type", defaults.type);
+            spec.replicas = std::max(1u, entry.get<unsigned>("replicas", defaults.replicas));
+            spec.options.max_batch_size = std::max(1u, entry.get<unsigned>("batch", defaults.options.max_batch_size));
+
+            if(auto shape = entry.get_optional<std::string>("shape"))
+                spec.shape = parse_shape(*shape);
+
+            if(auto degrade = entry.get_optional<std::string>("degrade"))
+                spec.degraded_shapes = parse_shapes(*degrade);
+
+            if(auto precision = entry.get_optional<std::string>("precision"))
+                spec.options.precision = parse_precision(*precision);
+        }
+        catch(const boost::property_tree::ptree_error& e) {
+            throw std::runtime_error("Invalid entry in models config " + path + ": " + e.what());
+        }
+
+        if(spec.name.empty() || !names.insert(spec.name).second)
+            throw std::runtime_error("Model name '" + spec.name + "' is empty or used more than once");
+
+        if(!boost::iequals(spec.type, "v8") && !boost::iequals(spec.type, "v5"))
+            throw std::runtime_error("Invalid model type " + spec.type + " of model " + spec.name);
+
+        specs.push_back(std::move(spec));
+    }
+
+    if(specs.empty())
+        throw std::runtime_error("No models in " + path);
+
+    return specs;
+}
+
+std::vector<cv::Size> parse_shapes(const std::string& shapes)
+{
+    std::vector<std::string> items;
+    boost::split(items, shapes, boost::is_any_of(","), boost::token_compress_on);
+
+    std::vector<cv::Size> parsed;
+    for(auto& item: items)
+    {
+        boost::trim(item);
+
+        if(!item.empty())
+            parsed.push_back(parse_shape(item));
+    }
+
+    std::sort(parsed.begin(), parsed.end(), [](const cv::Size& a, const cv::Size& b) { return a.area() > b.area(); });
+
+    return parsed;
+}
+
+std::unique_ptr<detection_model> create_model(const model_spec& spec, const std::string& dir)
+{
+    if(boost::iequals(spec.type, "v5")) {
+        spdlog::info("Creating model v5 '{}' ({}, {}x{})", spec.name, spec.file, spec.shape.width, spec.shape.height);
+        return std::make_unique<yolo_v5>(spec.shape, dir, spec.file, spec.options);
+    }
+
+    spdlog::info("Creating model v8 '{}' ({}, {}x{})", spec.name, spec.file, spec.shape.width, spec.shape.height);
+    return std::make_unique<yolo_v8>(spec.shape, dir, spec.file, spec.options);
+}
+
+std::vector<std::unique_ptr<detection_model>> create_model_variants(const model_spec& spec, const std::string& dir)
+{
+    std::vector<std::unique_ptr<detection_model>> variants;
+    variants.push_back(create_model(spec, dir));
+
+    for(const auto& shape: spec.degraded_shapes)
+    {
+        // a variant larger than the model itself would not relieve anything
+        if(shape.area() >= spec.shape.area())
+            continue;
+
+        auto variant = spec;
+        variant.shape = shape;
+        variants.push_back(create_model(variant, dir));
+    }
+
+    return variants;
+}
@@ -0,0 +1,202 @@
+#include "../inc/ai/nms.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace
+{
+    // buffers of callers that bring none, reused between calls of the same thread
+    thread_local nms::nms_scratch local_scratch;
+    thread_local unsigned long long local_growth_events = 0;
+
+    template <typename V>
+    inline void reserve(V& buffer, std::size_t size, unsigned long long& growth_events)
+    {
+        if(buffer.capacity() < size) {
+            ++growth_events;
+            buffer.reserve(size);
+        }
+    }
+
+    template <typename V, typename E>
+    inline void push(V& buffer, E value, unsigned long long& growth_events)
+    {
+        if(buffer.size() == buffer.capacity())
+            ++growth_events;
+
+        buffer.push_back(value);
+    }
+
+    // below that many candidates the grid costs more than it saves
+    constexpr std::size_t brute_force_limit = 64;
+
+    // upper bound of grid cells per axis
+    constexpr int max_grid_size = 64;
+
+    inline float iou(const cv::Rect2f& a, const cv::Rect2f& b)
+    {
+        const float width = std::min(a.x + a.width, b.x + b.width) - std::max(a.x, b.x);
+        const float height = std::min(a.y + a.height, b.y + b.height) - std::max(a.y, b.y);
+
+        if(width <= 0.0f || height <= 0.0f)
+            return 0.0f;
+
+        const float intersection = width * height;
+        const float united = a.width * a.height + b.width * b.height - intersection;
+
+        return united > 0.0f ? intersection / united : 0.0f;
+    }
+
+    inline bool overlaps(const nms::nms_input& input, const nms::nms_params& params, int candidate, int kept)
+    {
+        if(params.class_aware && input.class_ids[candidate] != input.class_ids[kept])
+            return false;
+
+        return iou(input.boxes[candidate], input.boxes[kept]) > params.iou_threshold;
+    }
+}
+
+void nms::suppress(const nms_input& input, const nms_params& params, std::vector<int>& keep)
+{
+    suppress(input, params, keep, local_scratch, local_growth_events);
+}
+
+void nms::suppress(const nms_input& input, const nms_params& params, std::vector<int>& keep, nms_scratch& scratch, unsigned long long& growth_events)
+{
+    keep.clear();
+
+    auto& order = scratch.order;
+
+    order.clear();
+    reserve(order, input.count, growth_events);
+
+    for(std::size_t i = 0; i < input.count; i++)
+        if(input.scores[i] > params.score_threshold)
+            order.emplace_back(input.scores[i], static_cast<int>(i));
+
+    if(order.empty())
+        return;
+
+    // best score first, ties keep the candidate order
+    const auto better = [](const std::pair<float, int>& a, const std::pair<float, int>& b) {
+        return a.first > b.first || (a.first == b.first && a.second < b.second);
+    };
+
+    if(params.top_k > 0 && order.size() > params.top_k) {
+        std::partial_sort(order.begin(), order.begin() + params.top_k, order.end(), better);
+        order.resize(params.top_k);
+    }
+    else {
+        std::sort(order.begin(), order.end(), better);
+    }
+
+    const std::size_t limit = params.max_detections > 0 ? params.max_detections : order.size();
+
+    // every push below stays within the reserved capacity
+    reserve(keep, std::min(limit, order.size()), growth_events);
+
+    if(order.size() <= brute_force_limit)
+    {
+        for(const auto& [score, candidate]: order)
+        {
+            const bool suppressed = std::any_of(keep.begin(), keep.end(), [&](int kept) {
+                return overlaps(input, params, candidate, kept);
+            });
+
+            if(suppressed)
+                continue;
+
+            keep.push_back(candidate);
+            if(keep.size() == limit)
+                break;
+        }
+
+        return;
+    }
+
+    // grid over the candidates' extent with cells about the size of an average box
+    float min_x = std::numeric_limits<float>::max(), min_y = std::numeric_limits<float>::max();
+    float max_x = std::numeric_limits<float>::lowest(), max_y = std::numeric_limits<float>::lowest();
+    float extent = 0.0f;
+
+    for(const auto& [score, candidate]: order)
+    {
+        const auto& box = input.boxes[candidate];
+        min_x = std::min(min_x, box.x);
+        min_y = std::min(min_y, box.y);
+        max_x = std::max(max_x, box.x + box.width);
+        max_y = std::max(max_y, box.y + box.height);
+        extent += std::max(box.width, box.height);
+    }
+
+    const float cell = std::max(extent / order.size(), 1.0f);
+    const int cols = std::clamp(static_cast<int>(std::ceil((max_x - min_x) / cell)), 1, max_grid_size);
+    const int rows = std::clamp(static_cast<int>(std::ceil((max_y - min_y) / cell)), 1, max_grid_size);
+    const float cell_width = std::max((max_x - min_x) / cols, 1.0f);
+    const float cell_height = std::max((max_y - min_y) / rows, 1.0f);
+
+    auto& cells = scratch.cells;
+    auto& touched = scratch.touched;
+
+    for(int c: touched)
+        cells[c].clear();
+    touched.clear();
+
+    if(cells.size() < static_cast<std::size_t>(cols * rows)) {
+        ++growth_events;
+        cells.resize(cols * rows);
+    }
+
+    const auto cell_range = [&](const cv::Rect2f& box, int& c0, int& c1, int& r0, int& r1) {
+        c0 = std::clamp(static_cast<int>((box.x - min_x) / cell_width), 0, cols - 1);
+        c1 = std::clamp(static_cast<int>((box.x + box.width - min_x) / cell_width), 0, cols - 1);
+        r0 = std::clamp(static_cast<int>((box.y - min_y) / cell_height), 0, rows - 1);
+        r1 = std::clamp(static_cast<int>((box.y + box.height - min_y) / cell_height), 0, rows - 1);
+    };
+
+    for(const auto& [score, candidate]: order)
+    {
+        int c0, c1, r0, r1;
+        cell_range(input.boxes[candidate], c0, c1, r0, r1);
+
+        // overlapping boxes share at least one cell
+        bool suppressed = false;
+        for(int r = r0; r <= r1 && !suppressed; r++)
+            for(int c = c0; c <= c1 && !suppressed; c++)
+                for(int kept: cells[r * cols + c])
+                    if(overlaps(input, params, candidate, kept)) {
+                        suppressed = true;
+                        break;
+                    }
+
+        if(suppressed)
+            continue;
+
+        keep.push_back(candidate);
+        if(keep.size() == limit)
+            break;
+
+        for(int r = r0; r <= r1; r++)
+            for(int c = c0; c <= c1; c++)
+            {
+                auto& bucket = cells[r * cols + c];
+                if(bucket.empty())
+                    push(touched, r * cols + c, growth_events);
+
+                push(bucket, candidate, growth_events);
+            }
+    }
+}
+
+void nms::suppress_batch(const std::vector<nms_input>& inputs, const nms_params& params, std::vector<std::vector<int>>& keep)
+{
+    keep.resize(inputs.size());
+
+    cv::parallel_for_(cv::Range(0, static_cast<int>(inputs.size())), [&](const cv::Range& range)
+    {
+        for(int i = range.start; i < range.end; i++)
+            suppress(inputs[i], params, keep[i]);
+    });
+}
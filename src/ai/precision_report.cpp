@@ -0,0 +1,167 @@
+#include "../inc/ai/precision_report.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include <spdlog/spdlog.h>
+
+namespace
+{
+    constexpr float match_iou = 0.5f;
+
+    float iou(const detection& a, const detection& b)
+    {
+        const float width = std::min(a.x + a.width, b.x + b.width) - std::max(a.x, b.x);
+        const float height = std::min(a.y + a.height, b.y + b.height) - std::max(a.y, b.y);
+
+        if(width <= 0.0f || height <= 0.0f)
+            return 0.0f;
+
+        const float intersection = width * height;
+        return intersection / (a.width * a.height + b.width * b.height - intersection);
+    }
+
+    /**
+     * @brief Runs every frame through the model, one at a time
+     * @returns detections per frame, latencies [out] per frame
+    */
+    std::vector<std::vector<detection>> run(detection_model& model, const std::vector<cv::Mat>& frames, std::vector<double>& latencies)
+    {
+        std::vector<std::vector<detection>> detections(frames.size());
+        std::vector<cv::Mat> batch(1);
+        std::vector<std::vector<detection>> results;
+
+        latencies.clear();
+
+        for(std::size_t i = 0; i < frames.size(); i++)
+        {
+            batch[0] = frames[i];
+
+            cv::TickMeter meter;
+            meter.start();
+            model.object_detection_batch(batch, results);
+            meter.stop();
+
+            latencies.push_back(meter.getTimeMilli());
+            detections[i] = results.at(0);
+        }
+
+        return detections;
+    }
+
+    /**
+     * @brief Greedily matches detections of the same class and accumulates their deviation
+    */
+    void compare(const std::vector<detection>& reference, const std::vector<detection>& candidate, precision_report& report, double& iou_sum, double& delta_sum)
+    {
+        std::vector<bool> used(candidate.size(), false);
+
+        for(const auto& expected: reference)
+        {
+            int best = -1;
+            float best_iou = match_iou;
+
+            for(std::size_t j = 0; j < candidate.size(); j++)
+            {
+                if(used[j] || candidate[j].class_id != expected.class_id)
+                    continue;
+
+                const float overlap = iou(expected, candidate[j]);
+                if(overlap >= best_iou) {
+                    best_iou = overlap;
+                    best = static_cast<int>(j);
+                }
+            }
+
+            if(best < 0) {
+                report.missing++;
+                continue;
+            }
+
+            used[best] = true;
+            report.matched++;
+
+            const double delta = std::abs(expected.confidence - candidate[best].confidence);
+            iou_sum += best_iou;
+            delta_sum += delta;
+            report.max_score_delta = std::max(report.max_score_delta, delta);
+        }
+
+        report.extra += std::count(used.begin(), used.end(), false);
+    }
+
+    double percentile(std::vector<double> values, double p)
+    {
+        const std::size_t index = std::min(values.size() - 1, static_cast<std::size_t>(p * values.size()));
+        std::nth_element(values.begin(), values.begin() + index, values.end());
+        return values[index];
+    }
+}
+
+std::vector<precision_report> compare_precisions(
+    const model_factory& factory, const model_options& options,
+    const std::vector<cv::Mat>& frames, const std::vector<precision_mode>& modes)
+{
+    std::vector<precision_report> reports;
+
+    if(frames.empty())
+        return reports;
+
+    std::vector<precision_mode> order{ precision_mode::fp32 };
+    for(auto mode: modes)
+        if(mode != precision_mode::fp32)
+            order.push_back(mode);
+
+    std::vector<std::vector<detection>> reference;
+    std::vector<double> latencies;
+
+    for(auto mode: order)
+    {
+        model_options run_options = options;
+        run_options.precision = mode;
+
+        std::unique_ptr<detection_model> model;
+        try {
+            model = factory(run_options);
+            model->warm_up();
+        }
+        catch(const std::exception& e) {
+            if(mode == precision_mode::fp32)
+                throw;
+
+            spdlog::error("Skipping {}: {}", to_string(mode), e.what());
+            continue;
+        }
+
+        const auto detections = run(*model, frames, latencies);
+
+        precision_report report;
+        report.precision = mode;
+        report.frames = frames.size();
+
+        const double total_ms = std::accumulate(latencies.begin(), latencies.end(), 0.0);
+        report.mean_ms = total_ms / latencies.size();
+        report.p50_ms = percentile(latencies, 0.50);
+        report.p95_ms = percentile(latencies, 0.95);
+        report.fps = total_ms > 0.0 ? latencies.size() / (total_ms / 1000.0) : 0.0;
+
+        if(mode == precision_mode::fp32)
+            reference = detections;
+
+        double iou_sum = 0.0;
+        double delta_sum = 0.0;
+
+        for(std::size_t i = 0; i < frames.size(); i++)
+            compare(reference[i], detections[i], report, iou_sum, delta_sum);
+
+        if(report.matched > 0) {
+            report.mean_iou = iou_sum / report.matched;
+            report.mean_score_delta = delta_sum / report.matched;
+        }
+
+        reports.push_back(report);
+    }
+
+    return reports;
+}
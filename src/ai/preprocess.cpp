@@ -0,0 +1,140 @@
+#include "../inc/ai/preprocess.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    /**
+     * Bilinear taps along the columns of the source frame, offsets are in bytes of a BGR row
+    */
+    struct column_taps
+    {
+        std::vector<int> first;
+        std::vector<int> second;
+        std::vector<float> weight;
+    };
+
+    // reused between frames, sized to the widest model input seen by the thread
+    thread_local column_taps taps_cache;
+
+    /**
+     * Source coordinate of an output pixel center (half-pixel centers as in cv::resize INTER_LINEAR)
+    */
+    inline void source_position(int dst, float factor, int src_size, int& first, int& second, float& weight)
+    {
+        float position = (dst + 0.5f) * factor - 0.5f;
+
+        if(position < 0.0f)
+            position = 0.0f;
+
+        first = static_cast<int>(position);
+        weight = position - first;
+
+        if(first >= src_size - 1) {
+            first = src_size - 1;
+            weight = 0.0f;
+        }
+
+        second = std::min(first + 1, src_size - 1);
+    }
+}
+
+void fill_tensor_image(float* dst, const cv::Size& shape, float value)
+{
+    std::fill(dst, dst + 3 * static_cast<std::size_t>(shape.area()), value);
+}
+
+letterbox_transform letterbox_to_tensor(const cv::Mat& source, float* dst, const cv::Size& shape, bool keep_aspect, float pad_value)
+{
+    cv::Mat src = source;
+
+    if(src.type() == CV_8UC1)
+        cv::cvtColor(source, src, cv::COLOR_GRAY2BGR);
+    else if(src.type() == CV_8UC4)
+        cv::cvtColor(source, src, cv::COLOR_BGRA2BGR);
+    else if(src.type() != CV_8UC3)
+        throw std::invalid_argument("letterbox_to_tensor: unsupported frame type " + std::to_string(src.type()));
+
+    // source pixels per model pixel
+    cv::Point2f factor(src.cols * 1.0f / shape.width, src.rows * 1.0f / shape.height);
+
+    if(keep_aspect)
+        factor.x = factor.y = std::max(factor.x, factor.y);
+
+    const int width = std::clamp(static_cast<int>(std::lround(src.cols / factor.x)), 1, shape.width);
+    const int height = std::clamp(static_cast<int>(std::lround(src.rows / factor.y)), 1, shape.height);
+
+    auto& taps = taps_cache;
+    taps.first.resize(width);
+    taps.second.resize(width);
+    taps.weight.resize(width);
+
+    for(int x = 0; x < width; x++)
+    {
+        int first, second;
+        source_position(x, factor.x, src.cols, first, second, taps.weight[x]);
+        taps.first[x] = first * 3;
+        taps.second[x] = second * 3;
+    }
+
+    const float norm = 1.0f / 255.0f;
+    const std::size_t area = static_cast<std::size_t>(shape.area());
+
+    float* plane_r = dst;
+    float* plane_g = dst + area;
+    float* plane_b = dst + 2 * area;
+
+    cv::parallel_for_(cv::Range(0, shape.height), [&](const cv::Range& range)
+    {
+        for(int y = range.start; y < range.end; y++)
+        {
+            float* r = plane_r + static_cast<std::size_t>(y) * shape.width;
+            float* g = plane_g + static_cast<std::size_t>(y) * shape.width;
+            float* b = plane_b + static_cast<std::size_t>(y) * shape.width;
+
+            if(y >= height)
+            {
+                std::fill(r, r + shape.width, pad_value);
+                std::fill(g, g + shape.width, pad_value);
+                std::fill(b, b + shape.width, pad_value);
+                continue;
+            }
+
+            int top, bottom;
+            float fy;
+            source_position(y, factor.y, src.rows, top, bottom, fy);
+
+            const uchar* row0 = src.ptr<uchar>(top);
+            const uchar* row1 = src.ptr<uchar>(bottom);
+
+            for(int x = 0; x < width; x++)
+            {
+                const int c0 = taps.first[x];
+                const int c1 = taps.second[x];
+                const float fx = taps.weight[x];
+
+                float bgr[3];
+                for(int ch = 0; ch < 3; ch++)
+                {
+                    const float upper = row0[c0 + ch] + (row0[c1 + ch] - row0[c0 + ch]) * fx;
+                    const float lower = row1[c0 + ch] + (row1[c1 + ch] - row1[c0 + ch]) * fx;
+                    bgr[ch] = upper + (lower - upper) * fy;
+                }
+
+                b[x] = bgr[0] * norm;
+                g[x] = bgr[1] * norm;
+                r[x] = bgr[2] * norm;
+            }
+
+            std::fill(r + width, r + shape.width, pad_value);
+            std::fill(g + width, g + shape.width, pad_value);
+            std::fill(b + width, b + shape.width, pad_value);
+        }
+    });
+
+    letterbox_transform transform;
+    transform.scale = factor;
+    return transform;
+}
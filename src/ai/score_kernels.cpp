@@ -0,0 +1,591 @@
+#include "../inc/ai/score_kernels.hpp"
+
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+    #define KERNELS_X86 1
+    #include <immintrin.h>
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+    #define KERNELS_NEON 1
+    #include <arm_neon.h>
+#endif
+
+namespace
+{
+    using planar_argmax_fn = std::size_t (*)(const float*, std::size_t, std::size_t, std::size_t, float, int*, int*, float*);
+    using strided_select_fn = std::size_t (*)(const float*, std::size_t, std::size_t, float, int*);
+    using row_argmax_fn = int (*)(const float*, std::size_t, float&);
+    using sum_abs_diff_fn = std::uint64_t (*)(const std::uint8_t*, const std::uint8_t*, std::size_t);
+
+    struct kernel_table
+    {
+        const char* name;
+        planar_argmax_fn planar_argmax;
+        strided_select_fn strided_select;
+        row_argmax_fn row_argmax;
+        sum_abs_diff_fn sum_abs_diff;
+    };
+
+    /**
+     * Scalar reference, also used for the tails the vector loops leave behind
+    */
+    std::size_t planar_argmax_range(
+        const float* scores, std::size_t classes, std::size_t begin, std::size_t end, std::size_t stride, float threshold,
+        int* indices, int* class_ids, float* class_scores, std::size_t kept)
+    {
+        for(std::size_t a = begin; a < end; a++)
+        {
+            float best = scores[a];
+            int best_class = 0;
+
+            for(std::size_t c = 1; c < classes; c++)
+            {
+                const float value = scores[c * stride + a];
+                if(value > best) {
+                    best = value;
+                    best_class = static_cast<int>(c);
+                }
+            }
+
+            if(best > threshold)
+            {
+                indices[kept] = static_cast<int>(a);
+                class_ids[kept] = best_class;
+                class_scores[kept] = best;
+                ++kept;
+            }
+        }
+
+        return kept;
+    }
+
+    std::size_t planar_argmax_scalar(
+        const float* scores, std::size_t classes, std::size_t anchors, std::size_t stride, float threshold,
+        int* indices, int* class_ids, float* class_scores)
+    {
+        return planar_argmax_range(scores, classes, 0, anchors, stride, threshold, indices, class_ids, class_scores, 0);
+    }
+
+    std::size_t strided_select_range(const float* column, std::size_t begin, std::size_t end, std::size_t stride, float threshold, int* indices, std::size_t kept)
+    {
+        for(std::size_t r = begin; r < end; r++)
+            if(column[r * stride] >= threshold)
+                indices[kept++] = static_cast<int>(r);
+
+        return kept;
+    }
+
+    std::size_t strided_select_scalar(const float* column, std::size_t rows, std::size_t stride, float threshold, int* indices) {
+        return strided_select_range(column, 0, rows, stride, threshold, indices, 0);
+    }
+
+    int row_argmax_range(const float* row, std::size_t begin, std::size_t length, float& best, int best_id)
+    {
+        for(std::size_t i = begin; i < length; i++)
+        {
+            if(row[i] > best) {
+                best = row[i];
+                best_id = static_cast<int>(i);
+            }
+        }
+
+        return best_id;
+    }
+
+    int row_argmax_scalar(const float* row, std::size_t length, float& best)
+    {
+        best = row[0];
+        return row_argmax_range(row, 1, length, best, 0);
+    }
+
+    std::uint64_t sum_abs_diff_range(const std::uint8_t* a, const std::uint8_t* b, std::size_t begin, std::size_t length, std::uint64_t sum)
+    {
+        for(std::size_t i = begin; i < length; i++)
+            sum += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+
+        return sum;
+    }
+
+    std::uint64_t sum_abs_diff_scalar(const std::uint8_t* a, const std::uint8_t* b, std::size_t length) {
+        return sum_abs_diff_range(a, b, 0, length, 0);
+    }
+
+    /**
+     * Reduces per-lane maxima to the first occurrence of the overall maximum
+    */
+    int reduce_lanes(const float* values, const int* ids, std::size_t lanes, float& best)
+    {
+        best = values[0];
+        int best_id = ids[0];
+
+        for(std::size_t lane = 1; lane < lanes; lane++)
+        {
+            if(values[lane] > best || (values[lane] == best && ids[lane] < best_id)) {
+                best = values[lane];
+                best_id = ids[lane];
+            }
+        }
+
+        return best_id;
+    }
+
+#if defined(KERNELS_X86)
+
+    __attribute__((target("avx2")))
+    inline std::size_t compact_avx2(
+        __m256 best, __m256i ids, std::size_t anchor, __m256 threshold,
+        int* indices, int* class_ids, float* class_scores, std::size_t kept)
+    {
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(best, threshold, _CMP_GT_OQ));
+
+        if(mask == 0)
+            return kept;
+
+        alignas(32) float lane_scores[8];
+        alignas(32) int lane_ids[8];
+        _mm256_store_ps(lane_scores, best);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lane_ids), ids);
+
+        while(mask)
+        {
+            const int lane = __builtin_ctz(mask);
+            indices[kept] = static_cast<int>(anchor) + lane;
+            class_ids[kept] = lane_ids[lane];
+            class_scores[kept] = lane_scores[lane];
+            ++kept;
+            mask &= mask - 1;
+        }
+
+        return kept;
+    }
+
+    __attribute__((target("avx2")))
+    std::size_t planar_argmax_avx2(
+        const float* scores, std::size_t classes, std::size_t anchors, std::size_t stride, float threshold,
+        int* indices, int* class_ids, float* class_scores)
+    {
+        constexpr std::size_t lanes = 8;
+        const __m256 thr = _mm256_set1_ps(threshold);
+
+        std::size_t kept = 0;
+        std::size_t a = 0;
+
+        // two independent accumulators hide the compare/blend latency of the running max
+        for(; a + 2 * lanes <= anchors; a += 2 * lanes)
+        {
+            __m256 best0 = _mm256_loadu_ps(scores + a);
+            __m256 best1 = _mm256_loadu_ps(scores + a + lanes);
+            __m256i ids0 = _mm256_setzero_si256();
+            __m256i ids1 = _mm256_setzero_si256();
+
+            for(std::size_t c = 1; c < classes; c++)
+            {
+                const float* plane = scores + c * stride + a;
+                const __m256i id = _mm256_set1_epi32(static_cast<int>(c));
+
+                const __m256 v0 = _mm256_loadu_ps(plane);
+                const __m256 v1 = _mm256_loadu_ps(plane + lanes);
+                const __m256 gt0 = _mm256_cmp_ps(v0, best0, _CMP_GT_OQ);
+                const __m256 gt1 = _mm256_cmp_ps(v1, best1, _CMP_GT_OQ);
+
+                best0 = _mm256_blendv_ps(best0, v0, gt0);
+                best1 = _mm256_blendv_ps(best1, v1, gt1);
+                ids0 = _mm256_blendv_epi8(ids0, id, _mm256_castps_si256(gt0));
+                ids1 = _mm256_blendv_epi8(ids1, id, _mm256_castps_si256(gt1));
+            }
+
+            kept = compact_avx2(best0, ids0, a, thr, indices, class_ids, class_scores, kept);
+            kept = compact_avx2(best1, ids1, a + lanes, thr, indices, class_ids, class_scores, kept);
+        }
+
+        for(; a + lanes <= anchors; a += lanes)
+        {
+            __m256 best = _mm256_loadu_ps(scores + a);
+            __m256i ids = _mm256_setzero_si256();
+
+            for(std::size_t c = 1; c < classes; c++)
+            {
+                const __m256 v = _mm256_loadu_ps(scores + c * stride + a);
+                const __m256 gt = _mm256_cmp_ps(v, best, _CMP_GT_OQ);
+
+                best = _mm256_blendv_ps(best, v, gt);
+                ids = _mm256_blendv_epi8(ids, _mm256_set1_epi32(static_cast<int>(c)), _mm256_castps_si256(gt));
+            }
+
+            kept = compact_avx2(best, ids, a, thr, indices, class_ids, class_scores, kept);
+        }
+
+        return planar_argmax_range(scores, classes, a, anchors, stride, threshold, indices, class_ids, class_scores, kept);
+    }
+
+    __attribute__((target("avx2")))
+    std::size_t strided_select_avx2(const float* column, std::size_t rows, std::size_t stride, float threshold, int* indices)
+    {
+        constexpr std::size_t lanes = 8;
+
+        // gather offsets are 32-bit
+        if(rows * stride >= static_cast<std::size_t>(INT_MAX))
+            return strided_select_scalar(column, rows, stride, threshold, indices);
+
+        const __m256 thr = _mm256_set1_ps(threshold);
+        const __m256i step = _mm256_set1_epi32(static_cast<int>(lanes * stride));
+        __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(static_cast<int>(stride)));
+
+        std::size_t kept = 0;
+        std::size_t r = 0;
+
+        for(; r + lanes <= rows; r += lanes)
+        {
+            const __m256 v = _mm256_i32gather_ps(column, offsets, 4);
+            int mask = _mm256_movemask_ps(_mm256_cmp_ps(v, thr, _CMP_GE_OQ));
+
+            while(mask)
+            {
+                indices[kept++] = static_cast<int>(r) + __builtin_ctz(mask);
+                mask &= mask - 1;
+            }
+
+            offsets = _mm256_add_epi32(offsets, step);
+        }
+
+        return strided_select_range(column, r, rows, stride, threshold, indices, kept);
+    }
+
+    __attribute__((target("avx2")))
+    int row_argmax_avx2(const float* row, std::size_t length, float& best)
+    {
+        constexpr std::size_t lanes = 8;
+
+        if(length < lanes)
+            return row_argmax_scalar(row, length, best);
+
+        __m256 values = _mm256_loadu_ps(row);
+        __m256i ids = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        __m256i current = ids;
+        const __m256i step = _mm256_set1_epi32(static_cast<int>(lanes));
+
+        std::size_t i = lanes;
+        for(; i + lanes <= length; i += lanes)
+        {
+            current = _mm256_add_epi32(current, step);
+
+            const __m256 v = _mm256_loadu_ps(row + i);
+            const __m256 gt = _mm256_cmp_ps(v, values, _CMP_GT_OQ);
+
+            values = _mm256_blendv_ps(values, v, gt);
+            ids = _mm256_blendv_epi8(ids, current, _mm256_castps_si256(gt));
+        }
+
+        alignas(32) float lane_values[lanes];
+        alignas(32) int lane_ids[lanes];
+        _mm256_store_ps(lane_values, values);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lane_ids), ids);
+
+        const int best_id = reduce_lanes(lane_values, lane_ids, lanes, best);
+        return row_argmax_range(row, i, length, best, best_id);
+    }
+
+    __attribute__((target("avx2")))
+    std::uint64_t sum_abs_diff_avx2(const std::uint8_t* a, const std::uint8_t* b, std::size_t length)
+    {
+        constexpr std::size_t lanes = 32;
+
+        // vpsadbw sums the differences of every 8 bytes into a 64-bit lane
+        __m256i sums = _mm256_setzero_si256();
+
+        std::size_t i = 0;
+        for(; i + lanes <= length; i += lanes)
+        {
+            const __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            const __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+            sums = _mm256_add_epi64(sums, _mm256_sad_epu8(va, vb));
+        }
+
+        alignas(32) std::uint64_t lane_sums[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lane_sums), sums);
+
+        return sum_abs_diff_range(a, b, i, length, lane_sums[0] + lane_sums[1] + lane_sums[2] + lane_sums[3]);
+    }
+
+    __attribute__((target("avx512f")))
+    std::size_t planar_argmax_avx512(
+        const float* scores, std::size_t classes, std::size_t anchors, std::size_t stride, float threshold,
+        int* indices, int* class_ids, float* class_scores)
+    {
+        constexpr std::size_t lanes = 16;
+        const __m512 thr = _mm512_set1_ps(threshold);
+        const __m512i lane_offsets = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+        std::size_t kept = 0;
+        std::size_t a = 0;
+
+        for(; a < anchors; a += lanes)
+        {
+            // masked loads cover the tail, inactive lanes never pass the threshold test
+            const std::size_t active = anchors - a < lanes ? anchors - a : lanes;
+            const __mmask16 tail = static_cast<__mmask16>((1u << active) - 1u);
+
+            __m512 best = _mm512_maskz_loadu_ps(tail, scores + a);
+            __m512i ids = _mm512_setzero_si512();
+
+            for(std::size_t c = 1; c < classes; c++)
+            {
+                const __m512 v = _mm512_maskz_loadu_ps(tail, scores + c * stride + a);
+                const __mmask16 gt = _mm512_cmp_ps_mask(v, best, _CMP_GT_OQ);
+
+                best = _mm512_mask_blend_ps(gt, best, v);
+                ids = _mm512_mask_blend_epi32(gt, ids, _mm512_set1_epi32(static_cast<int>(c)));
+            }
+
+            const __mmask16 keep = _mm512_mask_cmp_ps_mask(tail, best, thr, _CMP_GT_OQ);
+
+            if(keep == 0)
+                continue;
+
+            const __m512i anchor_ids = _mm512_add_epi32(_mm512_set1_epi32(static_cast<int>(a)), lane_offsets);
+            _mm512_mask_compressstoreu_epi32(indices + kept, keep, anchor_ids);
+            _mm512_mask_compressstoreu_epi32(class_ids + kept, keep, ids);
+            _mm512_mask_compressstoreu_ps(class_scores + kept, keep, best);
+
+            kept += static_cast<std::size_t>(__builtin_popcount(keep));
+        }
+
+        return kept;
+    }
+
+    __attribute__((target("avx512f")))
+    std::size_t strided_select_avx512(const float* column, std::size_t rows, std::size_t stride, float threshold, int* indices)
+    {
+        constexpr std::size_t lanes = 16;
+
+        if(rows * stride >= static_cast<std::size_t>(INT_MAX))
+            return strided_select_scalar(column, rows, stride, threshold, indices);
+
+        const __m512 thr = _mm512_set1_ps(threshold);
+        const __m512i lane_offsets = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+        const __m512i step = _mm512_set1_epi32(static_cast<int>(lanes * stride));
+        __m512i offsets = _mm512_mullo_epi32(lane_offsets, _mm512_set1_epi32(static_cast<int>(stride)));
+
+        std::size_t kept = 0;
+        std::size_t r = 0;
+
+        for(; r + lanes <= rows; r += lanes)
+        {
+            const __m512 v = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xFFFF, offsets, column, 4);
+            const __mmask16 keep = _mm512_cmp_ps_mask(v, thr, _CMP_GE_OQ);
+
+            if(keep != 0)
+            {
+                const __m512i row_ids = _mm512_add_epi32(_mm512_set1_epi32(static_cast<int>(r)), lane_offsets);
+                _mm512_mask_compressstoreu_epi32(indices + kept, keep, row_ids);
+                kept += static_cast<std::size_t>(__builtin_popcount(keep));
+            }
+
+            offsets = _mm512_add_epi32(offsets, step);
+        }
+
+        return strided_select_range(column, r, rows, stride, threshold, indices, kept);
+    }
+
+    __attribute__((target("avx512f")))
+    int row_argmax_avx512(const float* row, std::size_t length, float& best)
+    {
+        constexpr std::size_t lanes = 16;
+
+        if(length < lanes)
+            return row_argmax_scalar(row, length, best);
+
+        __m512 values = _mm512_loadu_ps(row);
+        __m512i ids = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+        __m512i current = ids;
+        const __m512i step = _mm512_set1_epi32(static_cast<int>(lanes));
+
+        std::size_t i = lanes;
+        for(; i + lanes <= length; i += lanes)
+        {
+            current = _mm512_add_epi32(current, step);
+
+            const __m512 v = _mm512_loadu_ps(row + i);
+            const __mmask16 gt = _mm512_cmp_ps_mask(v, values, _CMP_GT_OQ);
+
+            values = _mm512_mask_blend_ps(gt, values, v);
+            ids = _mm512_mask_blend_epi32(gt, ids, current);
+        }
+
+        alignas(64) float lane_values[lanes];
+        alignas(64) int lane_ids[lanes];
+        _mm512_store_ps(lane_values, values);
+        _mm512_store_si512(lane_ids, ids);
+
+        const int best_id = reduce_lanes(lane_values, lane_ids, lanes, best);
+        return row_argmax_range(row, i, length, best, best_id);
+    }
+
+#elif defined(KERNELS_NEON)
+
+    std::size_t planar_argmax_neon(
+        const float* scores, std::size_t classes, std::size_t anchors, std::size_t stride, float threshold,
+        int* indices, int* class_ids, float* class_scores)
+    {
+        constexpr std::size_t lanes = 4;
+
+        std::size_t kept = 0;
+        std::size_t a = 0;
+
+        for(; a + lanes <= anchors; a += lanes)
+        {
+            float32x4_t best = vld1q_f32(scores + a);
+            uint32x4_t ids = vdupq_n_u32(0);
+
+            for(std::size_t c = 1; c < classes; c++)
+            {
+                const float32x4_t v = vld1q_f32(scores + c * stride + a);
+                const uint32x4_t gt = vcgtq_f32(v, best);
+
+                best = vbslq_f32(gt, v, best);
+                ids = vbslq_u32(gt, vdupq_n_u32(static_cast<uint32_t>(c)), ids);
+            }
+
+            float lane_scores[lanes];
+            uint32_t lane_ids[lanes];
+            vst1q_f32(lane_scores, best);
+            vst1q_u32(lane_ids, ids);
+
+            for(std::size_t lane = 0; lane < lanes; lane++)
+            {
+                if(lane_scores[lane] > threshold)
+                {
+                    indices[kept] = static_cast<int>(a + lane);
+                    class_ids[kept] = static_cast<int>(lane_ids[lane]);
+                    class_scores[kept] = lane_scores[lane];
+                    ++kept;
+                }
+            }
+        }
+
+        return planar_argmax_range(scores, classes, a, anchors, stride, threshold, indices, class_ids, class_scores, kept);
+    }
+
+    int row_argmax_neon(const float* row, std::size_t length, float& best)
+    {
+        constexpr std::size_t lanes = 4;
+
+        if(length < lanes)
+            return row_argmax_scalar(row, length, best);
+
+        const uint32_t first_ids[lanes] = { 0, 1, 2, 3 };
+
+        float32x4_t values = vld1q_f32(row);
+        uint32x4_t ids = vld1q_u32(first_ids);
+        uint32x4_t current = ids;
+        const uint32x4_t step = vdupq_n_u32(static_cast<uint32_t>(lanes));
+
+        std::size_t i = lanes;
+        for(; i + lanes <= length; i += lanes)
+        {
+            current = vaddq_u32(current, step);
+
+            const float32x4_t v = vld1q_f32(row + i);
+            const uint32x4_t gt = vcgtq_f32(v, values);
+
+            values = vbslq_f32(gt, v, values);
+            ids = vbslq_u32(gt, current, ids);
+        }
+
+        float lane_values[lanes];
+        int lane_ids[lanes];
+        vst1q_f32(lane_values, values);
+        vst1q_s32(lane_ids, vreinterpretq_s32_u32(ids));
+
+        const int best_id = reduce_lanes(lane_values, lane_ids, lanes, best);
+        return row_argmax_range(row, i, length, best, best_id);
+    }
+
+    std::uint64_t sum_abs_diff_neon(const std::uint8_t* a, const std::uint8_t* b, std::size_t length)
+    {
+        constexpr std::size_t lanes = 16;
+
+        uint32x4_t sums = vdupq_n_u32(0);
+
+        std::size_t i = 0;
+        for(; i + lanes <= length; i += lanes)
+        {
+            // widen the byte differences pairwise before they can overflow
+            const uint8x16_t diff = vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i));
+            sums = vpadalq_u16(sums, vpaddlq_u8(diff));
+        }
+
+        const std::uint64_t sum = vgetq_lane_u32(sums, 0) + static_cast<std::uint64_t>(vgetq_lane_u32(sums, 1))
+            + vgetq_lane_u32(sums, 2) + vgetq_lane_u32(sums, 3);
+
+        return sum_abs_diff_range(a, b, i, length, sum);
+    }
+
+#endif
+
+    bool is_requested(const char* requested, const char* name) {
+        return requested == nullptr || std::strcmp(requested, name) == 0;
+    }
+
+    /**
+     * Picks the widest instruction set supported by the CPU.
+     * KERNELS_ISA environment variable (scalar, avx2, avx512, neon) narrows the choice e.g. for verification
+    */
+    kernel_table resolve_kernels()
+    {
+        const char* requested = std::getenv("KERNELS_ISA");
+
+#if defined(KERNELS_X86)
+        __builtin_cpu_init();
+
+        if(is_requested(requested, "avx512") && __builtin_cpu_supports("avx512f"))
+            return { "avx512", planar_argmax_avx512, strided_select_avx512, row_argmax_avx512, sum_abs_diff_avx2 }; // vpsadbw needs avx512bw
+
+        if(is_requested(requested, "avx2") && __builtin_cpu_supports("avx2"))
+            return { "avx2", planar_argmax_avx2, strided_select_avx2, row_argmax_avx2, sum_abs_diff_avx2 };
+#elif defined(KERNELS_NEON)
+        if(is_requested(requested, "neon"))
+            return { "neon", planar_argmax_neon, strided_select_scalar, row_argmax_neon, sum_abs_diff_neon }; // no gather on NEON
+#endif
+
+        return { "scalar", planar_argmax_scalar, strided_select_scalar, row_argmax_scalar, sum_abs_diff_scalar };
+    }
+
+    const kernel_table& kernels_in_use()
+    {
+        static const kernel_table table = resolve_kernels();
+        return table;
+    }
+}
+
+std::size_t kernels::planar_argmax_select(
+    const float* scores, std::size_t classes, std::size_t anchors, std::size_t stride, float threshold,
+    int* indices, int* class_ids, float* class_scores)
+{
+    if(classes == 0 || anchors == 0)
+        return 0;
+
+    return kernels_in_use().planar_argmax(scores, classes, anchors, stride, threshold, indices, class_ids, class_scores);
+}
+
+std::size_t kernels::strided_threshold_select(const float* column, std::size_t rows, std::size_t stride, float threshold, int* indices)
+{
+    if(rows == 0)
+        return 0;
+
+    return kernels_in_use().strided_select(column, rows, stride, threshold, indices);
+}
+
+int kernels::row_argmax(const float* row, std::size_t length, float& best) {
+    return kernels_in_use().row_argmax(row, length, best);
+}
+
+std::uint64_t kernels::sum_abs_diff(const std::uint8_t* a, const std::uint8_t* b, std::size_t length) {
+    return kernels_in_use().sum_abs_diff(a, b, length);
+}
+
+const char* kernels::instruction_set() {
+    return kernels_in_use().name;
+}
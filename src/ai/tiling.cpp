@@ -0,0 +1,123 @@
+#include "../inc/ai/tiling.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    /**
+     * @returns number of tiles of the given length covering the length with at least the given overlap
+    */
+    int tiles_along(int length, int tile, float overlap)
+    {
+        if(length <= tile)
+            return 1;
+
+        const float stride = std::max(1.0f, tile * (1.0f - overlap));
+        return static_cast<int>(std::ceil((length - tile) / stride)) + 1;
+    }
+
+    /**
+     * @returns offset of the i-th of `count` tiles, first and last tile touch the frame edges
+    */
+    int tile_offset(int i, int count, int length, int tile)
+    {
+        if(count <= 1)
+            return 0;
+
+        return static_cast<int>(std::lround(static_cast<double>(i) * (length - tile) / (count - 1)));
+    }
+}
+
+std::vector<cv::Rect> tiling::plan(const cv::Size& frame, const cv::Size& tile, float overlap, bool global_view, std::size_t max_tiles)
+{
+    const cv::Rect whole(0, 0, frame.width, frame.height);
+
+    if(frame.empty() || tile.empty())
+        return { whole };
+
+    overlap = std::clamp(overlap, 0.0f, 0.9f);
+    max_tiles = std::max<std::size_t>(1, max_tiles);
+
+    cv::Size size(std::min(tile.width, frame.width), std::min(tile.height, frame.height));
+
+    while(true)
+    {
+        const int cols = tiles_along(frame.width, size.width, overlap);
+        const int rows = tiles_along(frame.height, size.height, overlap);
+        const std::size_t count = static_cast<std::size_t>(cols) * rows;
+
+        if(count == 1)
+            return { whole };
+
+        if(count + (global_view ? 1 : 0) <= max_tiles)
+        {
+            std::vector<cv::Rect> regions;
+            regions.reserve(count + 1);
+
+            for(int r = 0; r < rows; r++)
+                for(int c = 0; c < cols; c++)
+                    regions.emplace_back(
+                        tile_offset(c, cols, frame.width, size.width),
+                        tile_offset(r, rows, frame.height, size.height),
+                        size.width,
+                        size.height);
+
+            if(global_view)
+                regions.push_back(whole);
+
+            return regions;
+        }
+
+        // too many tiles for one batch - fewer, larger tiles downscaled to the model input
+        size.width = std::min(frame.width, static_cast<int>(std::ceil(size.width * 1.25)));
+        size.height = std::min(frame.height, static_cast<int>(std::ceil(size.height * 1.25)));
+    }
+}
+
+void tiling::merge(const std::vector<detection>* results, const cv::Rect* regions, std::size_t count, const nms::nms_params& params, std::vector<detection>& merged, inference_workspace& ws)
+{
+    std::size_t candidates = 0;
+    for(std::size_t i = 0; i < count; i++)
+        candidates += results[i].size();
+
+    // the decoder is done with its scratch once the job is postprocessed
+    ws.ensure_capacity(ws.boxes, candidates);
+    ws.ensure_capacity(ws.confidences, candidates);
+    ws.ensure_capacity(ws.class_ids, candidates);
+
+    for(std::size_t i = 0; i < count; i++)
+        for(const auto& result: results[i])
+        {
+            ws.boxes.emplace_back(result.x + regions[i].x, result.y + regions[i].y, result.width, result.height);
+            ws.confidences.push_back(result.confidence);
+            ws.class_ids.push_back(result.class_id);
+        }
+
+    // candidates already passed the score threshold of their tile
+    auto merge_params = params;
+    merge_params.score_threshold = 0.0f;
+
+    nms::nms_input input;
+    input.boxes = ws.boxes.data();
+    input.scores = ws.confidences.data();
+    input.class_ids = ws.class_ids.data();
+    input.count = ws.boxes.size();
+
+    nms::suppress(input, merge_params, ws.nms_result, ws.nms, ws.growth_events);
+
+    ws.ensure_capacity(merged, ws.nms_result.size());
+
+    for(const auto index: ws.nms_result)
+    {
+        detection result;
+        result.x = ws.boxes[index].x;
+        result.y = ws.boxes[index].y;
+        result.width = ws.boxes[index].width;
+        result.height = ws.boxes[index].height;
+        result.class_id = ws.class_ids[index];
+        result.confidence = ws.confidences[index];
+
+        merged.push_back(result);
+    }
+}
@@ -1,7 +1,45 @@
 #include "../inc/ai/yolo.hpp"
+#include "../inc/ai/score_kernels.hpp"
 
-yolo::yolo(const cv::Size2f& size, const std::string& dir, const std::string& model)
-    : detection_model(size, dir, model)
+namespace
+{
+    /**
+     * @returns half precision variant of a DNN target, the target itself when there is none
+    */
+    cv::dnn::Target half_precision_target(cv::dnn::Target target)
+    {
+        switch(target)
+        {
+            case cv::dnn::DNN_TARGET_CUDA:
+                return cv::dnn::DNN_TARGET_CUDA_FP16;
+            case cv::dnn::DNN_TARGET_OPENCL:
+                return cv::dnn::DNN_TARGET_OPENCL_FP16;
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 9)
+            case cv::dnn::DNN_TARGET_CPU:
+                return cv::dnn::DNN_TARGET_CPU_FP16;
+#endif
+            default:
+                spdlog::warn("No FP16 variant of DNN target {} in OpenCV {}, running in FP32", static_cast<int>(target), CV_VERSION);
+                return target;
+        }
+    }
+
+    /**
+     * @returns file name of the INT8 quantized variant (e.g. yolov8n.onnx -> yolov8n_int8.onnx)
+    */
+    std::string quantized_model_name(const std::string& model)
+    {
+        const auto dot = model.find_last_of('.');
+
+        if(dot == std::string::npos)
+            return model + "_int8";
+
+        return model.substr(0, dot) + "_int8" + model.substr(dot);
+    }
+}
+
+yolo::yolo(const cv::Size2f& size, const std::string& dir, const std::string& model, const model_options& options)
+    : detection_model(size, dir, model, options)
 {
     this->load_classes();
     this->load_model();
@@ -10,40 +48,151 @@ yolo::yolo(const cv::Size2f& size, const std::string& dir, const std::string& mo
     std::mt19937 gen(rd());
     std::uniform_int_distribution<int> dis(50, 255);
     
-    for(int i = 0; i < classes.size(); i++)
-        colors.push_back(cv::Scalar(dis(gen), dis(gen), dis(gen)));
+    for(std::size_t i = 0; i < classes->size(); i++)
+        classes->colors.push_back(cv::Scalar(dis(gen), dis(gen), dis(gen)));
 
-    assert(colors.size() == classes.size());
+    assert(classes->colors.size() == classes->size());
+
+    this->init_job(this->local_job);
+}
+
+void yolo::init_job(inference_job& job)
+{
+    auto& ws = job.workspace;
+
+    // input tensor for the max batch size plus a header for every smaller batch
+    const int max_batch = static_cast<int>(std::max(1u, options.max_batch_size));
+    int dims[] = { max_batch, 3, static_cast<int>(model_shape.height), static_cast<int>(model_shape.width) };
+    ws.input.create(4, dims, CV_32F);
+
+    ws.input_views.clear();
+    ws.input_views.reserve(max_batch);
+    for(int n = 1; n <= max_batch; n++) {
+        dims[0] = n;
+        ws.input_views.emplace_back(4, dims, CV_32F, ws.input.data);
+    }
+
+    ws.transforms.resize(max_batch);
+    ws.output_names = this->network.getUnconnectedOutLayersNames();
+
+    job.count = 0;
+    job.blank.assign(max_batch, 0);
+    job.results.resize(max_batch);
+}
+
+std::unique_ptr<inference_job> yolo::create_job()
+{
+    auto job = std::make_unique<inference_job>();
+    this->init_job(*job);
+
+    return job;
 }
 
 
 void yolo::load_classes() {
     static std::vector<std::string> classes{"person", "bicycle", "car", "motorcycle", "airplane", "bus", "train", "truck", "boat", "traffic light", "fire hydrant", "stop sign", "parking meter", "bench", "bird", "cat", "dog", "horse", "sheep", "cow", "elephant", "bear", "zebra", "giraffe", "backpack", "umbrella", "handbag", "tie", "suitcase", "frisbee", "skis", "snowboard", "sports ball", "kite", "baseball bat", "baseball glove", "skateboard", "surfboard", "tennis racket", "bottle", "wine glass", "cup", "fork", "knife", "spoon", "bowl", "banana", "apple", "sandwich", "orange", "broccoli", "carrot", "hot dog", "pizza", "donut", "cake", "chair", "couch", "potted plant", "bed", "dining table", "toilet", "tv", "laptop", "mouse", "remote", "keyboard", "cell phone", "microwave", "oven", "toaster", "sink", "refrigerator", "book", "clock", "vase", "scissors", "teddy bear", "hair drier", "toothbrush"};
 
-    this->classes = classes;
+    this->classes->names = classes;
 }
 
 void yolo::load_model() 
 {
-    this->network = cv::dnn::readNetFromONNX(this->dir_path+this->model_name);
+    const std::string model_file = this->options.precision == precision_mode::int8
+        ? quantized_model_name(this->model_name)
+        : this->model_name;
+
+    this->network = cv::dnn::readNetFromONNX(this->dir_path+model_file);
     
-    spdlog::info("Running on CUDA");
-    spdlog::info("Loaded model {}", this->dir_path+this->model_name);
+    spdlog::info("Running on {}", this->options.backend == cv::dnn::DNN_BACKEND_CUDA ? "CUDA" : "CPU/OpenCL");
+    spdlog::info("Loaded model {} ({})", this->dir_path+model_file, to_string(this->options.precision));
+    spdlog::info("Output decoding kernels: {}", kernels::instruction_set());
+
+    const cv::dnn::Target target = this->options.precision == precision_mode::fp16
+        ? half_precision_target(this->options.target)
+        : this->options.target;
+
+    this->network.setPreferableBackend(this->options.backend);
+    this->network.setPreferableTarget(target);
+}
+
+letterbox_transform yolo::prepare_input(const cv::Mat& frame, inference_workspace& ws, std::size_t slot)
+{
+    const cv::Size shape(this->model_shape);
+    float* dst = ws.input.ptr<float>(static_cast<int>(slot));
 
-    this->network.setPreferableBackend(cv::dnn::DNN_BACKEND_CUDA);
-    this->network.setPreferableTarget(cv::dnn::DNN_TARGET_CUDA);
+    if(frame.empty()) {
+        fill_tensor_image(dst, shape, 0.0f);
+        return {};
+    }
+
+    // non-square models keep being fed a stretched frame
+    const bool keep_aspect = letterBoxForSquare && shape.width == shape.height;
+    return letterbox_to_tensor(frame, dst, shape, keep_aspect);
 }
 
-cv::Mat yolo::formatToSquare(const cv::Mat& source)
+cv::Mat yolo::input_tensor(const inference_workspace& ws, std::size_t count)
 {
-    int col = source.cols;
-    int row = source.rows;
-    int _max = MAX(col, row);
+    if(this->options.fixed_batch)
+        return ws.input;
+
+    return ws.input_views.at(count - 1);
+}
+
+void yolo::preprocess(const cv::Mat* frames, std::size_t count, inference_job& job)
+{
+    auto& ws = job.workspace;
+    const std::size_t max_batch = std::max(1u, this->options.max_batch_size);
+
+    if(count == 0 || count > max_batch)
+        throw std::runtime_error("Job of " + std::to_string(count) + " frames does not fit the batch size of model " + this->model_name);
+
+    job.count = count;
+
+    // resize, letterbox, swap channels and normalize in one pass into the preallocated tensor,
+    // slots are independent so the images of a batch (e.g. tiles of one frame) are prepared in parallel
+    cv::parallel_for_(cv::Range(0, static_cast<int>(count)), [&](const cv::Range& range)
+    {
+        for(int i = range.start; i < range.end; i++)
+        {
+            job.blank[i] = frames[i].empty();
+            ws.transforms[i] = this->prepare_input(frames[i], ws, i);
+        }
+    });
 
-    if (col == _max && row == _max)
-        return source;
+    // static batch dimension - pad the tensor with blank frames
+    if(options.fixed_batch)
+        for(std::size_t i = count; i < max_batch; i++)
+            fill_tensor_image(ws.input.ptr<float>(static_cast<int>(i)), cv::Size(model_shape), 0.0f);
+}
+
+void yolo::forward(inference_job& job)
+{
+    auto& ws = job.workspace;
+
+    ws.ensure_size(ws.output_data, ws.outputs.size());
+    for(std::size_t i = 0; i < ws.outputs.size(); i++)
+        ws.output_data[i] = ws.outputs[i].data;
+
+    this->network.setInput(this->input_tensor(ws, job.count));
+    this->network.forward(ws.outputs, ws.output_names);
+
+    // the backend hands out its own blobs, they only move when it had to allocate
+    bool moved = ws.outputs.size() != ws.output_data.size();
+    for(std::size_t i = 0; i < ws.outputs.size() && !moved; i++)
+        moved = ws.outputs[i].data != ws.output_data[i];
+
+    if(moved)
+        ++ws.growth_events;
+}
+
+nms::nms_params yolo::get_nms_params() const
+{
+    nms::nms_params params;
+    params.score_threshold = modelScoreThreshold;
+    params.iou_threshold = modelNMSThreshold;
+    params.class_aware = options.class_aware_nms;
+    params.top_k = options.nms_top_k;
+    params.max_detections = options.max_detections;
 
-    cv::Mat result = cv::Mat::zeros(_max, _max, CV_8UC3);
-    source.copyTo(result(cv::Rect(0, 0, col, row)));
-    return result;
+    return params;
 }
\ No newline at end of file
@@ -1,89 +1,65 @@
 #include "../inc/ai/yolo_v5.hpp"
+#include "../inc/ai/score_kernels.hpp"
 
-yolo_v5::yolo_v5(cv::Size2f shape, const std::string& dir, const std::string& model)
-    : yolo_v8(shape, dir, model)
+yolo_v5::yolo_v5(cv::Size2f shape, const std::string& dir, const std::string& model, const model_options& options)
+    : yolo_v8(shape, dir, model, options)
 {
 }
 
-std::vector<detection> yolo_v5::object_detection(const cv::Mat& frame)
+void yolo_v5::decode_output(const cv::Mat& output, const letterbox_transform& transform, inference_workspace& ws, std::vector<detection>& detections)
 {
-    cv::Mat modelInput = frame;
-    if (letterBoxForSquare && model_shape.width == model_shape.height)
-        modelInput = formatToSquare(modelInput);
+    // yolov5 has an output of shape (25200, 85) per image (box[x,y,w,h] + objectness + Num classes)
+    const int rows = output.rows;
+    const int dimensions = output.cols;
+    const std::size_t class_count = std::min<std::size_t>(classes->size(), dimensions - 5);
 
-    cv::Mat blob;
-    cv::dnn::blobFromImage(modelInput, blob, 1.0/255.0, model_shape, cv::Scalar(), true, false);
-    this->network.setInput(blob);
+    const float *data = output.ptr<float>();
 
-    std::vector<cv::Mat> outputs;
-    this->network.forward(outputs, this->network.getUnconnectedOutLayersNames());
+    const float x_factor = transform.scale.x;
+    const float y_factor = transform.scale.y;
+    const float x_offset = transform.offset.x;
+    const float y_offset = transform.offset.y;
 
-    int rows = outputs[0].size[1];
-    int dimensions = outputs[0].size[2];
+    // first pass: strided scan of the objectness column, compacts the candidate rows
+    ws.ensure_size(ws.candidates, rows);
+    const std::size_t candidate_count = kernels::strided_threshold_select(
+        data + 4, rows, dimensions, this->modelConfidenceThreshold, ws.candidates.data());
 
-    float *data = (float *)outputs[0].data;
+    // second pass: class argmax and boxes for the candidates only
+    ws.ensure_capacity(ws.class_ids, candidate_count);
+    ws.ensure_capacity(ws.confidences, candidate_count);
+    ws.ensure_capacity(ws.boxes, candidate_count);
 
-    float x_factor = modelInput.cols / model_shape.width;
-    float y_factor = modelInput.rows / model_shape.height;
-
-    std::vector<int> class_ids;
-    std::vector<float> confidences;
-    std::vector<cv::Rect> boxes;
-
-    for (int i = 0; i < rows; ++i)
+    for (std::size_t i = 0; i < candidate_count; ++i)
     {
-        float confidence = data[4];
-
-        if (confidence >= this->modelConfidenceThreshold)
-        {
-            float *classes_scores = data+5;
-
-            cv::Mat scores(1, classes.size(), CV_32FC1, classes_scores);
-            cv::Point class_id;
-            double max_class_score;
-
-            minMaxLoc(scores, 0, &max_class_score, 0, &class_id);
+        const float *row = data + static_cast<std::size_t>(ws.candidates[i]) * dimensions;
 
-            if (max_class_score > modelScoreThreshold)
-            {
-                confidences.push_back(confidence);
-                class_ids.push_back(class_id.x);
+        float max_class_score;
+        const int class_id = kernels::row_argmax(row + 5, class_count, max_class_score);
 
-                float x = data[0];
-                float y = data[1];
-                float w = data[2];
-                float h = data[3];
+        // same as upstream yolov5: the score is objectness times class score
+        // anything not above the score threshold would be dropped by NMS anyway
+        const float confidence = row[4] * max_class_score;
 
-                int left = int((x - 0.5 * w) * x_factor);
-                int top = int((y - 0.5 * h) * y_factor);
+        if (confidence <= modelScoreThreshold)
+            continue;
 
-                int width = int(w * x_factor);
-                int height = int(h * y_factor);
+        ws.confidences.push_back(confidence);
+        ws.class_ids.push_back(class_id);
 
-                boxes.push_back(cv::Rect(left, top, width, height));
-            }
-        }
+        float x = row[0];
+        float y = row[1];
+        float w = row[2];
+        float h = row[3];
 
-        data += dimensions;
-    }
-
-    std::vector<int> nms_result;
-    cv::dnn::NMSBoxes(boxes, confidences, modelScoreThreshold, modelNMSThreshold, nms_result);
+        float left = (x - 0.5f * w - x_offset) * x_factor;
+        float top = (y - 0.5f * h - y_offset) * y_factor;
 
-    std::vector<detection> detections{};
-    for (unsigned long i = 0; i < nms_result.size(); ++i)
-    {
-        int idx = nms_result[i];
+        float width = w * x_factor;
+        float height = h * y_factor;
 
-        detection result;
-        result.class_id = class_ids[idx];
-        result.confidence = confidences[idx];
-        result.color = colors[result.class_id];
-        result.class_name = classes[result.class_id];
-        result.box = boxes[idx];
-
-        detections.push_back(result);
+        ws.boxes.emplace_back(left, top, width, height);
     }
 
-    return detections;
-}
\ No newline at end of file
+    this->collect_detections(ws, detections);
+}
@@ -1,8 +1,10 @@
 #include "../inc/ai/yolo_v8.hpp"
+#include "../inc/ai/score_kernels.hpp"
+#include "../inc/ai/nms.hpp"
 
 
-yolo_v8::yolo_v8(const cv::Size2f& size, const std::string& dir, const std::string& model)
-    : yolo(size, dir, model)
+yolo_v8::yolo_v8(const cv::Size2f& size, const std::string& dir, const std::string& model, const model_options& options)
+    : yolo(size, dir, model, options)
 {
 }
 
@@ -12,11 +14,15 @@ const std::string_view yolo_v8::get_model_name() {
 }
 
 const std::vector<std::string>& yolo_v8::get_classes(){
-    return this->classes;
+    return this->classes->names;
 }
 
 const std::vector<cv::Scalar>&  yolo_v8::get_colors(){
-    return this->colors;
+    return this->classes->colors;
+}
+
+unsigned yolo_v8::get_max_batch_size() {
+    return std::max(1u, this->options.max_batch_size);
 }
 
 std::vector<detection> yolo_v8::object_detection(const cv::Mat& img) {
@@ -26,108 +32,163 @@ std::vector<detection> yolo_v8::object_detection(const cv::Mat& img) {
 
 std::vector<std::vector<detection>> yolo_v8::object_detection_batch(const std::vector<cv::Mat>& batch) 
 {
-    /* DYNAMIC BATCH SIZE IS NOT SUPPORTED AFAIR */
-    /* BUT MAYBE I WILL FIND WORKAROUND LATER */
-    /* FOR NOW PROCCES THIS FIRST IMG FROM BATCH */
-
-    if(batch.empty())
-        return {};
+    std::vector<std::vector<detection>> batch_detections{};
+    this->object_detection_batch(batch, batch_detections);
+    return batch_detections;
+}
 
-    cv::Mat modelInput = batch[0];
+void yolo_v8::object_detection_batch(const std::vector<cv::Mat>& batch, std::vector<std::vector<detection>>& batch_detections)
+{
+    auto& job = this->local_job;
+    auto& ws = job.workspace;
 
-    if (letterBoxForSquare && model_shape.width == model_shape.height)
-        modelInput = formatToSquare(modelInput);
+    // resize() would destroy the surplus lists and their capacity, park them for the next larger batch instead
+    if(batch_detections.capacity() < batch.size())
+        ++ws.growth_events;
 
-    if(modelInput.empty())
-        return {};
+    while(batch_detections.size() > batch.size()) {
+        job.spare_results.push_back(std::move(batch_detections.back()));
+        batch_detections.pop_back();
+    }
 
-    const bool swapRB = true;
-    const unsigned batchSize = 1;
+    while(batch_detections.size() < batch.size())
+    {
+        if(job.spare_results.empty()) {
+            ++ws.growth_events;
+            batch_detections.emplace_back();
+            continue;
+        }
 
-    cv::Mat blob;
-    cv::dnn::blobFromImage(modelInput, blob, 1.0f/255.0f, model_shape, cv::Scalar(), swapRB, false);
-    this->network.setInput(blob);
+        batch_detections.push_back(std::move(job.spare_results.back()));
+        job.spare_results.pop_back();
+    }
 
-    std::vector<cv::Mat> outputs;
-    this->network.forward(outputs, this->network.getUnconnectedOutLayersNames());
+    if(batch.empty())
+        return;
 
-    std::vector<std::vector<detection>> batch_detections{};
+    const std::size_t max_batch = this->get_max_batch_size();
 
-    // yolov8 has an output of shape (batchSize, 84,  8400) (Num classes + box[x,y,w,h])
-    for(unsigned batch = 0; batch < batchSize; batch++)
+    // split oversized batches into chunks the network is able to take in one forward pass
+    for(std::size_t offset = 0; offset < batch.size(); offset += max_batch)
     {
-        int rows = outputs[batch].size[1];
-        int dimensions = outputs[batch].size[2];
-        
-        rows = outputs[batch].size[2];
-        dimensions = outputs[batch].size[1];
+        const std::size_t count = std::min(max_batch, batch.size() - offset);
 
-        outputs[batch] = outputs[batch].reshape(1, dimensions);
-        cv::transpose(outputs[batch], outputs[batch]);
-        
-        float *data = (float *)outputs[batch].data;
+        this->preprocess(batch.data() + offset, count, job);
+        this->forward(job);
+        this->postprocess(job);
+
+        // swapping keeps the capacity of both sides circulating instead of copying
+        for(std::size_t i = 0; i < count; i++)
+            std::swap(batch_detections[offset + i], job.results[i]);
+    }
+}
 
-        float x_factor = (modelInput.cols*1.0f) / model_shape.width;
-        float y_factor = (modelInput.rows*1.0f) / model_shape.height;
+void yolo_v8::postprocess(inference_job& job)
+{
+    auto& ws = job.workspace;
 
-        std::vector<int> class_ids;
-        std::vector<float> confidences;
-        std::vector<cv::Rect> boxes;
+    // output of shape (batchSize, ...) - one 2D plane per image
+    const cv::Mat& output = ws.outputs.at(0);
 
-        for (int i = 0; i < rows; ++i)
-        {
-            float *classes_scores = data+4;
+    if(output.dims != 3 || output.size[0] < static_cast<int>(job.count))
+        throw std::runtime_error("Unexpected output shape of model " + this->model_name);
 
-            cv::Mat scores(1, classes.size(), CV_32FC1, classes_scores);
-            cv::Point class_id;
-            double maxClassScore;
+    for(std::size_t i = 0; i < job.count; i++)
+    {
+        auto& detections = job.results[i];
 
-            minMaxLoc(scores, 0, &maxClassScore, 0, &class_id);
+        // keep the slot so the results stay aligned with the batch
+        if(job.blank[i]) {
+            detections.clear();
+            continue;
+        }
 
-            if (maxClassScore > this->modelConfidenceThreshold)
-            {
-                confidences.push_back(maxClassScore);
-                class_ids.push_back(class_id.x);
+        const cv::Mat plane(output.size[1], output.size[2], CV_32FC1, const_cast<float*>(output.ptr<float>(static_cast<int>(i))));
+        this->decode_output(plane, ws.transforms[i], ws, detections);
+    }
+}
 
-                float x = data[0];
-                float y = data[1];
-                float w = data[2];
-                float h = data[3];
+void yolo_v8::decode_output(const cv::Mat& output, const letterbox_transform& transform, inference_workspace& ws, std::vector<detection>& detections)
+{
+    // yolov8 has an output of shape (84, 8400) per image (box[x,y,w,h] + Num classes)
+    // stored class-major: every row is a plane with one value per anchor
+    const int anchors = output.cols;
+    const int dimensions = output.rows;
+    const std::size_t class_count = std::min<std::size_t>(classes->size(), dimensions - 4);
+
+    const float *data = output.ptr<float>();
+    const float *plane_x = data;
+    const float *plane_y = data + anchors;
+    const float *plane_w = data + 2*anchors;
+    const float *plane_h = data + 3*anchors;
+
+    const float x_factor = transform.scale.x;
+    const float y_factor = transform.scale.y;
+    const float x_offset = transform.offset.x;
+    const float y_offset = transform.offset.y;
+
+    ws.ensure_size(ws.candidates, anchors);
+    ws.ensure_size(ws.class_ids, anchors);
+    ws.ensure_size(ws.confidences, anchors);
+
+    // running per-anchor max/argmax across the class planes, only anchors above threshold survive
+    const std::size_t kept = kernels::planar_argmax_select(
+        data + 4*anchors, class_count, anchors, anchors, this->modelConfidenceThreshold,
+        ws.candidates.data(), ws.class_ids.data(), ws.confidences.data());
+
+    ws.class_ids.resize(kept);
+    ws.confidences.resize(kept);
+    ws.ensure_capacity(ws.boxes, kept);
+
+    for (std::size_t i = 0; i < kept; ++i)
+    {
+        const int anchor = ws.candidates[i];
 
-                int left = int((x - 0.5 * w) * x_factor);
-                int top = int((y - 0.5 * h) * y_factor);
+        float x = plane_x[anchor];
+        float y = plane_y[anchor];
+        float w = plane_w[anchor];
+        float h = plane_h[anchor];
 
-                int width = int(w * x_factor);
-                int height = int(h * y_factor);
+        float left = (x - 0.5f * w - x_offset) * x_factor;
+        float top = (y - 0.5f * h - y_offset) * y_factor;
 
-                boxes.push_back(cv::Rect(left, top, width, height));
-            }
-            
-            data += dimensions;
-        }
+        float width = w * x_factor;
+        float height = h * y_factor;
 
-        std::vector<int> nms_result;
-        cv::dnn::NMSBoxes(boxes, confidences, modelScoreThreshold, modelNMSThreshold, nms_result);
+        ws.boxes.emplace_back(left, top, width, height);
+    }
 
-        std::vector<detection> detections{};
-        for (unsigned long i = 0; i < nms_result.size(); ++i)
-        {
-            int idx = nms_result[i];
+    this->collect_detections(ws, detections);
+}
 
-            detection result;
-            result.class_id = class_ids[idx];
-            result.confidence = confidences[idx];
-            result.color = colors[result.class_id];
-            result.class_name = classes[result.class_id];
-            result.box = boxes[idx];
+void yolo_v8::collect_detections(inference_workspace& ws, std::vector<detection>& detections)
+{
+    const auto params = this->get_nms_params();
 
-            detections.push_back(result);
-        }
+    nms::nms_input input;
+    input.boxes = ws.boxes.data();
+    input.scores = ws.confidences.data();
+    input.class_ids = ws.class_ids.data();
+    input.count = ws.boxes.size();
 
-        batch_detections.emplace_back(detections);
-    }
+    nms::suppress(input, params, ws.nms_result, ws.nms, ws.growth_events);
 
-    return batch_detections;
+    ws.ensure_capacity(detections, ws.nms_result.size());
+    for (unsigned long i = 0; i < ws.nms_result.size(); ++i)
+    {
+        int idx = ws.nms_result[i];
+        const auto& box = ws.boxes[idx];
+
+        detection result;
+        result.x = box.x;
+        result.y = box.y;
+        result.width = box.width;
+        result.height = box.height;
+        result.class_id = ws.class_ids[idx];
+        result.confidence = ws.confidences[idx];
+
+        detections.push_back(result);
+    }
 }
 
 cv::Mat yolo_v8::apply_detections_on_image(const cv::Mat& img, const std::vector<detection>& detections) 
@@ -135,17 +196,14 @@ cv::Mat yolo_v8::apply_detections_on_image(const cv::Mat& img, const std::vector
     if(detections.empty())
         return img;
     
-    for (int i = 0; i < detections.size(); ++i)
+    for (const auto& detection: detections)
     {
-        auto detection = detections[i];
-
-        auto box = detection.box;
-        auto classId = detection.class_id;
-        const auto& color = detection.color;
+        const auto box = detection.box();
+        const auto& color = classes->color(detection.class_id);
         cv::rectangle(img, box, color, 3);
         
         std::ostringstream stringStream;
-        stringStream << detection.class_name << " - " << std::setprecision(4) << detection.confidence*100 << "%";
+        stringStream << classes->name(detection.class_id) << " - " << std::setprecision(4) << detection.confidence*100 << "%";
 
         cv::rectangle(img, cv::Point(box.x, box.y - 20), cv::Point(box.x + box.width, box.y), color, cv::FILLED);
         cv::putText(img,  stringStream.str(), cv::Point(box.x, box.y - 5), cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 0, 0));
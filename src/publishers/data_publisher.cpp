@@ -10,7 +10,7 @@ data_publisher::data_publisher(std::shared_ptr<rabbitmq_client> client, std::uni
 {
 }
 
-std::string json_converter::convert(const std::vector<detection>& results)
+std::string json_converter::convert(const std::vector<detection>& results, const class_table& classes)
 {
    boost::json::array array;
 
@@ -18,28 +18,36 @@ std::string json_converter::convert(const std::vector<detection>& results)
     {
         boost::json::object obj;
         obj["id"] = det.class_id;
-        obj["label"] = det.class_name;
+        obj["label"] = classes.name(det.class_id);
         obj["confidence"] = det.confidence*100;
-        obj["color"] = { det.color[0], det.color[1], det.color[2] };
-        obj["box"] = { {"x", det.box.x}, {"y", det.box.y}, {"width", det.box.width}, {"height", det.box.height} };
+
+        const auto& color = classes.color(det.class_id);
+        obj["color"] = { color[0], color[1], color[2] };
+
+        const auto box = det.box();
+        obj["box"] = { {"x", box.x}, {"y", box.y}, {"width", box.width}, {"height", box.height} };
+
+        if(det.track_id >= 0)
+            obj["track_id"] = det.track_id;
+
         array.emplace_back(obj);
     }
     
     return boost::json::serialize(array);
 }
 
-bool data_publisher::publish(unsigned src_id, const std::vector<detection>& result)
+bool data_publisher::publish(unsigned src_id, const std::vector<detection>& result, const class_table& classes)
 {
     if(!is_declared(src_id))
         declare_exchange(src_id, this->prefix);
 
-    auto data = data_converter->convert(result);
+    auto data = data_converter->convert(result, classes);
     AMQP::Envelope envelope(data);
     
     return rabbitmq->publish(declared_exchanges[src_id], "", envelope );
 }
 
-bool data_publisher::publish(unsigned src_id, const std::vector<detection>& results, unsigned limit)
+bool data_publisher::publish(unsigned src_id, const std::vector<detection>& results, const class_table& classes, unsigned limit)
 {
     auto shift = limit == 0 ? results.size() : limit;
 
@@ -48,9 +56,49 @@ bool data_publisher::publish(unsigned src_id, const std::vector<detection>& resu
     //auto subvec = std::vector<detection>(results.begin(), results.begin()+shift);
 
     if(results.empty())
-        this->publish(src_id, {});
+        this->publish(src_id, {}, classes);
     else
-        this->publish(src_id, results);
+        this->publish(src_id, results, classes);
 
     return true;
+}
+
+bool data_publisher::publish(unsigned src_id, const std::vector<detection>& results, const class_table& classes, frame_trace& trace, const result_info& info)
+{
+    if(!is_declared(src_id))
+        declare_exchange(src_id, this->prefix);
+
+    trace.start(trace_stage::serialize);
+    auto data = data_converter->convert(results, classes);
+    trace.stop(trace_stage::serialize);
+
+    AMQP::Envelope envelope(data);
+
+    AMQP::Table headers;
+
+    if(trace.captured_ms != 0)
+        headers.set("captured", static_cast<int64_t>(trace.captured_ms));
+
+    if(info.carried_over) {
+        headers.set("carried_over", true);
+        headers.set("result_age_ms", static_cast<int64_t>(info.result_age_ms));
+    }
+
+    if(info.predicted)
+        headers.set("predicted", true);
+
+    if(info.cached)
+        headers.set("cached", true);
+
+    if(info.input_width > 0)
+        headers.set("resolution", std::to_string(info.input_width) + "x" + std::to_string(info.input_height));
+
+    if(trace.captured_ms != 0 || info.carried_over || info.predicted || info.cached || info.input_width > 0)
+        envelope.setHeaders(headers);
+
+    trace.start(trace_stage::publish);
+    const bool published = rabbitmq->publish(declared_exchanges[src_id], "", envelope);
+    trace.stop(trace_stage::publish);
+
+    return published;
 }
\ No newline at end of file
@@ -211,3 +211,39 @@ bool message_bus_client::publish(const std::string_view &exchange, const std::st
 
     return false;
 }
+
+message_bus_client& message_bus_client::when_ready(std::shared_future<void> readiness, std::function<void()> action)
+{
+    auto deferred = std::make_unique<deferred_action>();
+    deferred->readiness = readiness;
+    deferred->action = action;
+    deferred->timer = event_new(evbase.get(), -1, EV_PERSIST, &message_bus_client::poll_readiness, deferred.get());
+
+    const auto interval = std::chrono::duration_cast<std::chrono::microseconds>(readiness_poll_interval).count();
+    const timeval tv { static_cast<time_t>(interval / 1000000), static_cast<suseconds_t>(interval % 1000000) };
+    event_add(deferred->timer, &tv);
+
+    deferred_actions.emplace_back(std::move(deferred));
+
+    return *this;
+}
+
+void message_bus_client::poll_readiness(evutil_socket_t, short, void* arg)
+{
+    auto deferred = static_cast<deferred_action*>(arg);
+
+    if(deferred->readiness.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return;
+
+    event_del(deferred->timer);
+
+    try {
+        deferred->readiness.get();
+    }
+    catch(const std::exception& e) {
+        spdlog::critical("Readiness signal failed: {}", e.what());
+        return;
+    }
+
+    deferred->action();
+}
@@ -1,4 +1,8 @@
 #include "../inc/rabbitmq/rabbitmq_client.hpp"
+#include "../inc/service/frame_pool.hpp"
+
+#include <cstring>
+
 #include <spdlog/spdlog.h>
 
 rabbitmq_client::rabbitmq_client(const std::string_view& connection_string) : message_bus_client(connection_string)
@@ -11,6 +15,14 @@ rabbitmq_client::rabbitmq_client(const std::string& av_que, const std::string& o
 }
 
 
+rabbitmq_client& rabbitmq_client::use_decode_pool(unsigned threads, std::size_t backlog)
+{
+    this->decoder = std::make_unique<decode_pool>(threads, backlog);
+    spdlog::info("Decoding compressed frames on {} thread(s), backlog of {} frames", decoder->size(), backlog);
+
+    return *this;
+}
+
 rabbitmq_client& rabbitmq_client::init_exchanges(const std::vector<std::pair<std::string, AMQP::ExchangeType>>& exchanges)
 {
     for(auto& exchange: exchanges)
@@ -35,7 +47,7 @@ rabbitmq_client& rabbitmq_client::bind_obsolete_sources(const std::string& excha
     return *this;
 }
 
-bool rabbitmq_client::validate_json(boost::property_tree::ptree ptree, source& src)
+bool rabbitmq_client::validate_json(boost::property_tree::ptree ptree, source_options& src)
 {
     auto id = ptree.get_child_optional("id");
 
@@ -51,6 +63,30 @@ bool rabbitmq_client::validate_json(boost::property_tree::ptree ptree, source& s
     {
         src.id = id->get<unsigned>("");
         src.exchange = exchange->get<std::string>("");
+        src.staleness_budget = std::chrono::milliseconds(ptree.get<unsigned>("staleness_budget_ms", 0));
+        src.keep_every = ptree.get<unsigned>("keep_every", 1);
+        src.target_fps = ptree.get<double>("target_fps", 0.0);
+        src.weight = ptree.get<unsigned>("weight", 1);
+        src.model = ptree.get<std::string>("model", "");
+        src.tiled = ptree.get<bool>("tiled", false);
+        src.tile_overlap = ptree.get<float>("tile_overlap", 0.2f);
+        src.global_view = ptree.get<bool>("global_view", true);
+        src.motion_threshold = ptree.get<float>("motion_threshold", 0.0f);
+        src.max_reuse_age = std::chrono::milliseconds(ptree.get<unsigned>("max_reuse_ms", 1000));
+        src.tracking = ptree.get<bool>("tracking", false);
+        src.detect_every = std::max(1u, ptree.get<unsigned>("detect_every", 1));
+        src.cache_size = ptree.get<std::size_t>("cache_size", 0);
+        src.near_duplicate_distance = ptree.get<unsigned>("near_duplicate_distance", 0);
+        src.priority = ptree.get<unsigned>("priority", 0);
+
+        const auto overflow = ptree.get<std::string>("overflow", "drop_newest");
+
+        if(overflow == "drop_oldest")
+            src.on_overflow = overflow_policy::drop_oldest;
+        else if(overflow == "drop_newest")
+            src.on_overflow = overflow_policy::drop_newest;
+        else 
+            spdlog::warn("Unknown overflow policy {}, using drop_newest", overflow);
     }
     catch (const boost::property_tree::ptree_error& e) {
         spdlog::error("JSON validation error: {}", e.what());
@@ -59,7 +95,7 @@ bool rabbitmq_client::validate_json(boost::property_tree::ptree ptree, source& s
     return true;
 }
 
-std::optional<source> rabbitmq_client::source_from_json(std::string json)
+std::optional<source_options> rabbitmq_client::source_from_json(std::string json)
 {
     std::stringstream ss;
     ss << json;
@@ -75,7 +111,7 @@ std::optional<source> rabbitmq_client::source_from_json(std::string json)
         return std::nullopt;
     }
 
-    source src;
+    source_options src;
     if(!validate_json(ptree, src))
         return std::nullopt;
 
@@ -94,8 +130,14 @@ AMQP::MessageCallback rabbitmq_client::available_src_msg_callback(detection_serv
            channel->ack(deliveryTag);
             return;
         }
+
+        if(decoder)
+        {
+            const auto stats = decoder->get_stats();
+            spdlog::debug("[Decode pool]: {} decoded \t{} reduced \t{} rejected \t{} pending", stats.decoded, stats.reduced, stats.rejected, stats.pending);
+        }
         
-        if(!visitor->visit_new_src(src->id)) {
+        if(!visitor->visit_new_src(*src)) {
            channel->ack(deliveryTag); // acknowledge anyway
             return;
         }
@@ -131,6 +173,10 @@ AMQP::MessageCallback rabbitmq_client::obsolete_src_msg_callback(detection_servi
            channel->unbindQueue(src->exchange, que.value(), ""); 
 
         detection_service::get_service_instance().unregister_source(src->id);
+
+        if(decoder)
+            decoder->forget(src->id);
+
         spdlog::info("Unregistered source (id:{}) from the service", src->id);
         
        channel->ack(deliveryTag);
@@ -144,6 +190,9 @@ AMQP::MessageCallback rabbitmq_client::new_frame_msg_callback(detection_service_
 {
     static AMQP::MessageCallback callback = [this, visitor](const AMQP::Message &message, uint64_t deliveryTag, bool redelivered)
     {
+        frame_trace trace;
+        trace.start(trace_stage::ingest);
+
         const std::string header = "srcid";
         auto& field = message.headers().get(header);
 
@@ -157,6 +206,9 @@ AMQP::MessageCallback rabbitmq_client::new_frame_msg_callback(detection_service_
 
         auto source_id = int(field);
 
+        trace.source_id = source_id;
+        trace.frame_id = ++frames_received;
+
         const std::string type = "imgtype";
         auto& type_header = message.headers().get(type);
 
@@ -167,6 +219,61 @@ AMQP::MessageCallback rabbitmq_client::new_frame_msg_callback(detection_service_
         }
         else imgtype = int(type_header);
 
+        // optional capture time (ms since epoch), lets stale frames be dropped before they are decoded
+        const std::string captured_field = "captured";
+        auto& captured_header = message.headers().get(captured_field);
+
+        auto origin = std::chrono::steady_clock::now();
+
+        if(captured_header.isInteger())
+        {
+            const auto captured = std::chrono::system_clock::time_point(std::chrono::milliseconds(int64_t(captured_header)));
+            const auto age = std::max(
+                std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - captured), 
+                std::chrono::milliseconds(0));
+
+            if(!visitor->visit_frame_age(source_id, age)) {
+                channel->ack(deliveryTag);
+                return;
+            }
+
+            origin -= age;
+
+            trace.captured_ms = int64_t(captured_header);
+            trace.span(trace_stage::transport, trace.begin[frame_trace::index(trace_stage::ingest)] - age, trace.begin[frame_trace::index(trace_stage::ingest)]);
+        }
+
+        // sampling policy of the source, skipped frames are never decoded
+        if(!visitor->visit_frame_admission(source_id)) {
+            channel->ack(deliveryTag);
+            return;
+        }
+
+        // frozen or republished frames are answered from the cache of the source without decoding, other sources skip the hash
+        std::uint64_t content = 0;
+
+        if(visitor->visit_cache_enabled(source_id))
+            content = result_cache::hash_bytes(message.body(), message.bodySize());
+
+        if(auto answer = content != 0 ? visitor->visit_frame_content(source_id, content) : nullptr)
+        {
+            trace.stop(trace_stage::ingest);
+
+            // behind the frames of the source still being decoded
+            if(decoder)
+            {
+                decoder->deliver(source_id, nullptr,
+                    [visitor, source_id, origin, trace, answer](std::shared_ptr<cv::Mat>, float)
+                    {
+                        visitor->visit_cached_frame(source_id, answer, origin, trace);
+                    });
+            }
+            else visitor->visit_cached_frame(source_id, answer, origin, trace);
+
+            channel->ack(deliveryTag);
+            return;
+        }
+
         int width = 0;
         int height = 0;
 
@@ -181,9 +288,30 @@ AMQP::MessageCallback rabbitmq_client::new_frame_msg_callback(detection_service_
 
         std::shared_ptr<cv::Mat> decoded_frame;
 
+        trace.stop(trace_stage::ingest);
+        trace.start(trace_stage::decode);
+
         try
         {
-            decoded_frame = std::make_shared<cv::Mat>();
+            // compressed frame - copy the bytes and leave the decoding to a worker, this thread only dispatches
+            if((width <= 0 || height <= 0 || imgtype <= 0) && decoder && message.bodySize() > 0)
+            {
+                auto payload = frame_pool::get_instance().acquire(1, static_cast<int>(message.bodySize()), CV_8UC1);
+                std::memcpy(payload->data, message.body(), message.bodySize());
+
+                // the decode stage includes the wait for a worker
+                decoder->submit(source_id, std::move(payload), visitor->visit_decode_target(source_id),
+                    [visitor, source_id, origin, trace, content](std::shared_ptr<cv::Mat> frame, float scale)
+                    {
+                        auto decoded_trace = trace;
+                        decoded_trace.stop(trace_stage::decode);
+
+                        visitor->visit_new_frame(source_id, frame, origin, decoded_trace, content, scale);
+                    });
+
+                channel->ack(deliveryTag);
+                return;
+            }
 
             if(width <= 0 || height <= 0 || imgtype <= 0)
             {
@@ -195,11 +323,17 @@ AMQP::MessageCallback rabbitmq_client::new_frame_msg_callback(detection_service_
             }
             else
             {
-                decoded_frame = std::make_shared<cv::Mat>(
-                    height, 
-                    width, 
-                    imgtype, 
-                    reinterpret_cast<void*>( const_cast<char*>(message.body())));
+                const auto bytes = static_cast<std::size_t>(width) * height * CV_ELEM_SIZE(imgtype);
+
+                if(message.bodySize() < bytes) {
+                    spdlog::error("Frame of source (id:{}) has {} bytes, {}x{} of type {} needs {}", source_id, message.bodySize(), width, height, imgtype, bytes);
+                    channel->ack(deliveryTag);
+                    return;
+                }
+
+                // the message body is freed once the callback returns, the frame lives on in the queues
+                decoded_frame = frame_pool::get_instance().acquire(height, width, imgtype);
+                std::memcpy(decoded_frame->data, message.body(), bytes);
             }
 
             if(decoded_frame->empty())
@@ -210,8 +344,17 @@ AMQP::MessageCallback rabbitmq_client::new_frame_msg_callback(detection_service_
                 blank.release();
             }
 
-            auto& service = detection_service::get_service_instance();
-            visitor->visit_new_frame(source_id, decoded_frame);
+            trace.stop(trace_stage::decode);
+
+            // behind the compressed frames of the source still being decoded
+            if(decoder)
+            {
+                decoder->deliver(source_id, decoded_frame, [visitor, source_id, origin, trace, content](std::shared_ptr<cv::Mat> frame, float)
+                {
+                    visitor->visit_new_frame(source_id, frame, origin, trace, content);
+                });
+            }
+            else visitor->visit_new_frame(source_id, decoded_frame, origin, trace, content);
         }
         catch(const std::bad_alloc& a) {
             spdlog::critical(a.what());
@@ -0,0 +1,286 @@
+#include "../inc/service/decode_pool.hpp"
+
+#include <algorithm>
+
+#include <spdlog/spdlog.h>
+
+namespace
+{
+    unsigned read_be16(const unsigned char* data) { return (unsigned(data[0]) << 8) | data[1]; }
+
+    unsigned read_be32(const unsigned char* data) { return (read_be16(data) << 16) | read_be16(data + 2); }
+
+    int reduced_flag(int reduction)
+    {
+        switch(reduction)
+        {
+            case 8: return cv::IMREAD_REDUCED_COLOR_8;
+            case 4: return cv::IMREAD_REDUCED_COLOR_4;
+            case 2: return cv::IMREAD_REDUCED_COLOR_2;
+            default: return cv::IMREAD_ANYCOLOR;
+        }
+    }
+}
+
+decode_pool::decode_pool(unsigned threads, std::size_t backlog)
+    : capacity(std::max<std::size_t>(1, backlog)), workers(threads)
+{
+}
+
+decode_pool::claim::claim(decode_pool* pool, std::shared_ptr<stream> source, unsigned long long ticket)
+    : pool(pool), source(std::move(source)), ticket(ticket)
+{
+}
+
+decode_pool::claim::~claim()
+{
+    if(completed)
+        return;
+
+    // the frame is lost, keep the order moving
+    source->pending--;
+    pool->pending--;
+
+    ready skipped;
+    skipped.deliver = [](std::shared_ptr<cv::Mat>, float) {};
+
+    pool->complete(*source, ticket, std::move(skipped));
+}
+
+void decode_pool::claim::complete(ready next)
+{
+    completed = true;
+    pool->complete(*source, ticket, std::move(next));
+}
+
+std::shared_ptr<decode_pool::stream> decode_pool::stream_of(unsigned source_id)
+{
+    std::lock_guard lock(streams_mutex);
+
+    auto& source = streams[source_id];
+    if(!source)
+        source = std::make_shared<stream>();
+
+    stream_count = streams.size();
+    return source;
+}
+
+void decode_pool::forget(unsigned source_id)
+{
+    std::lock_guard lock(streams_mutex);
+
+    // tasks in flight keep their stream alive until they are delivered
+    streams.erase(source_id);
+    stream_count = streams.size();
+}
+
+unsigned long long decode_pool::take_ticket(stream& source)
+{
+    std::lock_guard lock(source.mutex);
+    return source.next_ticket++;
+}
+
+void decode_pool::complete(stream& source, unsigned long long ticket, ready next)
+{
+    std::lock_guard lock(source.mutex);
+    source.finished.emplace(ticket, std::move(next));
+
+    // the lock keeps a single producer per source, deliver whatever is next in line
+    while(!source.finished.empty() && source.finished.begin()->first == source.next_delivery)
+    {
+        auto node = source.finished.extract(source.finished.begin());
+        source.next_delivery++;
+
+        auto& frame = node.mapped();
+
+        try {
+            frame.deliver(std::move(frame.frame), frame.scale);
+        }
+        catch(const std::exception& e) {
+            spdlog::error("[Decode pool]: {}", e.what());
+        }
+        catch(...) {
+            spdlog::error("[Decode pool]: Unknown Error");
+        }
+    }
+}
+
+bool decode_pool::submit(unsigned source_id, std::shared_ptr<cv::Mat> payload, cv::Size target, deliver_callback deliver)
+{
+    auto source = this->stream_of(source_id);
+
+    // a bursty source gets an equal share of the backlog, it cannot starve the others
+    const auto share = std::max<std::size_t>(1, capacity / std::max<std::size_t>(1, stream_count));
+
+    if(source->pending.fetch_add(1) >= share)
+    {
+        source->pending--;
+
+        const auto count = ++rejected;
+        if(count == 1 || count % 100 == 0)
+            spdlog::warn("[Decode pool]: Backlog share of {} frames full (source id:{}), {} frame(s) dropped so far", share, source_id, count);
+
+        return false;
+    }
+
+    if(pending.fetch_add(1) >= capacity)
+    {
+        pending--;
+        source->pending--;
+
+        const auto count = ++rejected;
+        if(count == 1 || count % 100 == 0)
+            spdlog::warn("[Decode pool]: Backlog of {} frames full, {} frame(s) dropped so far", capacity, count);
+
+        return false;
+    }
+
+    // completed by the task, or empty when the task is dropped without running
+    auto ticket = std::make_shared<claim>(this, source, this->take_ticket(*source));
+
+    workers.submit([this, ticket, payload = std::move(payload), target, deliver = std::move(deliver)]() mutable
+    {
+        ready next;
+        next.deliver = std::move(deliver);
+
+        try
+        {
+            cv::Size image;
+            int reduction = 1;
+
+            if(!target.empty() && read_image_size(payload->data, payload->total(), image))
+                reduction = reduction_for(image, target);
+
+            next.frame = std::make_shared<cv::Mat>();
+            cv::imdecode(*payload, reduced_flag(reduction), next.frame.get());
+
+            if(next.frame->empty())
+            {
+                spdlog::error("Could not decode image. Frame is empty");
+                *next.frame = cv::Mat::zeros(640, 640, CV_8UC3);
+            }
+            else if(reduction > 1)
+            {
+                // nominal factor - the decoder rounds the size up, and may rotate the frame by its EXIF orientation
+                next.scale = static_cast<float>(reduction);
+                reduced++;
+            }
+
+            decoded++;
+        }
+        catch(const std::exception& e) {
+            spdlog::error("[Decode pool]: {}", e.what());
+            next.frame.reset();
+        }
+        catch(...) {
+            spdlog::error("[Decode pool]: Unknown Error");
+            next.frame.reset();
+        }
+
+        // release the encoded bytes before waiting for the earlier frames of the source
+        payload.reset();
+        ticket->source->pending--;
+        pending--;
+
+        if(!next.frame) {
+            // keep the order moving, the frame is lost
+            next.deliver = [](std::shared_ptr<cv::Mat>, float) {};
+        }
+
+        ticket->complete(std::move(next));
+    });
+
+    return true;
+}
+
+void decode_pool::deliver(unsigned source_id, std::shared_ptr<cv::Mat> frame, deliver_callback deliver)
+{
+    auto source = this->stream_of(source_id);
+    const auto ticket = this->take_ticket(*source);
+
+    ready next;
+    next.frame = std::move(frame);
+    next.deliver = std::move(deliver);
+
+    this->complete(*source, ticket, std::move(next));
+}
+
+decode_stats decode_pool::get_stats() const
+{
+    decode_stats stats;
+    stats.decoded = decoded;
+    stats.reduced = reduced;
+    stats.rejected = rejected;
+    stats.pending = pending;
+
+    return stats;
+}
+
+bool decode_pool::read_image_size(const unsigned char* data, std::size_t size, cv::Size& image)
+{
+    static const unsigned char png_signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+    // PNG: signature, then the IHDR chunk with the big endian width and height
+    if(size >= 24 && std::equal(std::begin(png_signature), std::end(png_signature), data))
+    {
+        image = cv::Size(static_cast<int>(read_be32(data + 16)), static_cast<int>(read_be32(data + 20)));
+        return image.width > 0 && image.height > 0;
+    }
+
+    // JPEG: walk the marker segments up to the start of frame
+    if(size < 4 || data[0] != 0xFF || data[1] != 0xD8)
+        return false;
+
+    std::size_t pos = 2;
+
+    while(pos + 4 <= size)
+    {
+        if(data[pos] != 0xFF)
+            return false;
+
+        const unsigned char marker = data[pos + 1];
+
+        // fill bytes and markers without a segment
+        if(marker == 0xFF || marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+            pos += marker == 0xFF ? 1 : 2;
+            continue;
+        }
+
+        const std::size_t length = read_be16(data + pos + 2);
+
+        // SOF0-SOF15 except DHT, JPG and DAC: precision, height, width
+        const bool start_of_frame = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+
+        if(start_of_frame)
+        {
+            if(pos + 9 > size)
+                return false;
+
+            image = cv::Size(static_cast<int>(read_be16(data + pos + 7)), static_cast<int>(read_be16(data + pos + 5)));
+            return image.width > 0 && image.height > 0;
+        }
+
+        // scan data before the frame header - not a valid image
+        if(marker == 0xDA || length < 2)
+            return false;
+
+        pos += 2 + length;
+    }
+
+    return false;
+}
+
+int decode_pool::reduction_for(cv::Size image, cv::Size target)
+{
+    if(image.empty() || target.empty())
+        return 1;
+
+    // the letterbox shrinks the frame by `scale`, anything decoded above that size is thrown away
+    const double scale = std::min(static_cast<double>(target.width) / image.width, static_cast<double>(target.height) / image.height);
+
+    for(int reduction: { 8, 4, 2 })
+        if(reduction * scale <= 1.0)
+            return reduction;
+
+    return 1;
+}
@@ -1,5 +1,27 @@
 #include "../inc/service/detection_service.hpp"
+#include "../inc/service/frame_pool.hpp"
 #include "../inc/service/processing_service.hpp"
+#include "../inc/service/trace_recorder.hpp"
+#include "../inc/ai/tiling.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+    /**
+     * @brief Runs the action when the scope is left, whichever way it is left
+    */
+    template <typename F>
+    struct scope_exit
+    {
+        F action;
+        ~scope_exit() { action(); }
+    };
+
+    template <typename F>
+    scope_exit(F) -> scope_exit<F>;
+}
 
 template <typename T>
 basic_detection_service<T>& basic_detection_service<T>::get_service_instance()
@@ -16,7 +38,10 @@ std::thread basic_detection_service<T>::run_background_service()
 
 template <typename T>
 void basic_detection_service<T>::use_model(std::unique_ptr<detection_model>& ptr) {
-    this->model = std::move(ptr);
+    this->models.clear();
+    this->degraded_models.clear();
+    this->groups.clear();
+    this->add_replica(ptr);
 }
 
 template <typename T>
@@ -24,56 +49,447 @@ void basic_detection_service<T>::use_model(std::unique_ptr<detection_model>&& pt
     this->use_model(ptr);
 }
 
+template <typename T>
+void basic_detection_service<T>::add_replica(std::unique_ptr<detection_model>& ptr) {
+    this->add_replica(groups.empty() ? std::string("default") : groups.front()->name, std::move(ptr));
+}
+
+template <typename T>
+void basic_detection_service<T>::add_replica(const std::string& model, std::unique_ptr<detection_model>&& ptr)
+{
+    std::vector<std::unique_ptr<detection_model>> resolutions;
+    resolutions.push_back(std::move(ptr));
+
+    this->add_replica(model, std::move(resolutions));
+}
+
+template <typename T>
+void basic_detection_service<T>::add_replica(const std::string& model, std::vector<std::unique_ptr<detection_model>>&& resolutions)
+{
+    if(resolutions.empty() || !resolutions.front())
+        throw std::invalid_argument("[Detection service]: Replica of model '" + model + "' without a model");
+
+    const auto name = model.empty() ? std::string("default") : model;
+    auto index = this->find_group(name);
+
+    if(!index.has_value())
+    {
+        auto group = std::make_unique<model_group>();
+        group->name = name;
+        group->strategy = make_strategy();
+
+        index = groups.size();
+        groups.push_back(std::move(group));
+    }
+
+    groups[*index]->replicas.push_back(models.size());
+    this->models.emplace_back(std::move(resolutions.front()));
+
+    resolutions.erase(resolutions.begin());
+    this->degraded_models.emplace_back(std::move(resolutions));
+}
+
+template <typename T>
+std::optional<std::size_t> basic_detection_service<T>::find_group(const std::string& name) const
+{
+    if(groups.empty())
+        return std::nullopt;
+
+    if(name.empty())
+        return 0;
+
+    for(std::size_t i = 0; i < groups.size(); i++)
+        if(groups[i]->name == name)
+            return i;
+
+    return std::nullopt;
+}
+
+template <typename T>
+std::vector<std::string> basic_detection_service<T>::get_model_names() const
+{
+    std::vector<std::string> names;
+    for(const auto& group: groups)
+        names.push_back(group->name);
+
+    return names;
+}
+
+template <typename T>
+void basic_detection_service<T>::add_replica(std::unique_ptr<detection_model>&& ptr) {
+    this->add_replica(ptr);
+}
+
+template <typename T>
+void basic_detection_service<T>::set_threads_per_replica(int threads) {
+    this->threads_per_replica = threads;
+}
+
+template <typename T>
+void basic_detection_service<T>::set_pipeline(unsigned threads, unsigned depth) {
+    this->pipeline_threads = threads;
+    this->pipeline_depth = std::max(1u, depth);
+}
+
+template <typename T>
+void basic_detection_service<T>::set_resolution_control(std::chrono::milliseconds latency_target) {
+    this->degrade_latency = latency_target;
+}
+
 template <typename T>
 bool basic_detection_service<T>::register_source(const unsigned source_id) {
-    if(this->contains(source_id))
+    source_options options{};
+    options.id = source_id;
+
+    return this->register_source(options);
+}
+
+template <typename T>
+bool basic_detection_service<T>::register_source(const source_options& options) {
+    std::lock_guard lock(sources_mutex);
+
+    const auto current = std::atomic_load(&sources);
+    auto it = current->find(options.id);
+
+    if(it != current->end())
+    {
+        // a known source re-registering may come with a new weight
+        const auto weight = std::max(1u, options.weight);
+
+        if(it->second->weight.exchange(weight) != weight)
+            spdlog::info("[Detection service]: Source (id:{}) weight set to {}", options.id, weight);
+
+        return false;
+    }
+
+    const auto index = this->find_group(options.model);
+
+    if(!index.has_value()) {
+        spdlog::warn("[Detection service]: Source (id:{}) asks for unknown model '{}', not registered", options.id, options.model);
         return false;
+    }
 
-    queues.try_emplace(source_id);
-    que_mutexes.try_emplace(source_id);
-    dropped_frames.try_emplace(source_id, 0);
+    auto& group = *groups[*index];
+    const auto lane = std::make_shared<source_lane<T>>(options, max_size_per_que, *index);
+
+    auto updated = std::make_shared<source_table<T>>(*current);
+    updated->emplace(options.id, lane);
+    std::atomic_store(&sources, std::shared_ptr<const source_table<T>>(std::move(updated)));
+
+    auto group_updated = std::make_shared<source_table<T>>(*std::atomic_load(&group.sources));
+    group_updated->emplace(options.id, lane);
+    std::atomic_store(&group.sources, std::shared_ptr<const source_table<T>>(std::move(group_updated)));
+
+    spdlog::info("[Detection service]: Source (id:{}) served by model '{}'", options.id, group.name);
 
     return true;
 }
 
 template <typename T>
 bool basic_detection_service<T>::unregister_source(const unsigned source_id) {
-    if(!this->contains(source_id))
+    std::lock_guard lock(sources_mutex);
+
+    const auto current = std::atomic_load(&sources);
+    auto it = current->find(source_id);
+    if(it == current->end())
         return false;
 
-    std::lock_guard lock(inference_mutex); // block inference then safely remove
-    queues.erase(source_id);
-    que_mutexes.erase(source_id);
-    dropped_frames.erase(source_id);
+    const auto lane = it->second;
+    auto& group = *groups.at(lane->group);
+
+    auto updated = std::make_shared<source_table<T>>(*current);
+    updated->erase(source_id);
+    std::atomic_store(&sources, std::shared_ptr<const source_table<T>>(std::move(updated)));
+
+    auto group_updated = std::make_shared<source_table<T>>(*std::atomic_load(&group.sources));
+    group_updated->erase(source_id);
+    std::atomic_store(&group.sources, std::shared_ptr<const source_table<T>>(std::move(group_updated)));
+
+    // gathers after this one load the new table, the frames left are popped here and nowhere else
+    std::size_t drained = 0;
+
+    {
+        std::lock_guard schedule_lock(group.schedule_mutex);
+        std::lock_guard lane_lock(lane->consumer_mutex);
+
+        queued_frame<T> queued;
+        while(lane->frames.try_pop(queued))
+            drained++;
+    }
+
+    group.work.consume(drained);
 
     return true;
 }
 
+template <typename T>
+void basic_detection_service<T>::use_strategy(strategy_factory factory) {
+    this->make_strategy = std::move(factory);
+
+    for(auto& group: groups)
+    {
+        std::lock_guard lock(group->schedule_mutex);
+        group->strategy = make_strategy();
+    }
+}
+
 template <typename T>
 performance_metrics basic_detection_service<T>::get_performance() {
+    std::lock_guard lock(metrics_mutex);
+
+    double avg_time = 0.0;
+    double fps = 0.0;
+    double busy_ms = 0.0;
+    double idle_ms = 0.0;
+    unsigned long long wake_ups = 0;
+    unsigned long long wake_up_us = 0;
+
+    for(auto& replica: performance_meters)
+    {
+        busy_ms += replica.busy_ms;
+        idle_ms += replica.idle_ms;
+        wake_ups += replica.wake_ups;
+        wake_up_us += replica.wake_up_us;
+
+        if(replica.batches == 0)
+            continue;
+
+        avg_time += replica.latency_ms / replica.batches;
+        fps += replica.frames / (replica.busy_ms / 1000.0);
+    }
+
+    if(!performance_meters.empty())
+        avg_time /= performance_meters.size();
+
+    const auto lanes = std::atomic_load(&sources);
+    const auto degraded_sources = std::count_if(lanes->begin(), lanes->end(), [](const auto& entry) { return entry.second->level > 0; });
+
     return {
-        performance_meter.getAvgTimeMilli(),
-        performance_meter.getFPS(),
-        static_cast<unsigned>(queues.size()),
-        total_dropped_frames
+        avg_time,
+        fps,
+        static_cast<unsigned>(std::atomic_load(&sources)->size()),
+        total_frames_processed,
+        busy_ms + idle_ms > 0.0 ? idle_ms / (busy_ms + idle_ms) : 0.0,
+        wake_ups > 0 ? static_cast<double>(wake_up_us) / wake_ups : 0.0,
+        total_expired_frames,
+        total_skipped_frames,
+        total_overflow_frames,
+        total_carried_over_frames,
+        total_predicted_frames,
+        total_cached_frames,
+        total_degraded_frames,
+        static_cast<unsigned>(degraded_sources)
     };
 }
 
 template <typename T>
-bool basic_detection_service<T>::try_add_to_queue(const unsigned source_id, std::shared_ptr<T> frame)
+std::vector<source_share> basic_detection_service<T>::get_source_shares()
 {
-    if(!this->contains(source_id))
+    std::vector<source_share> shares;
+
+    // sources compete only with the sources of the same model
+    for(const auto& group: groups)
+    {
+        const auto snapshot = std::atomic_load(&group->sources);
+        const auto first = shares.size();
+
+        unsigned long long total_weight = 0;
+        unsigned long long total_frames = 0;
+
+        for(const auto& [id, lane]: *snapshot)
+        {
+            source_share share{};
+            share.id = id;
+            share.weight = lane->weight;
+            share.frames = lane->served;
+
+            total_weight += share.weight;
+            total_frames += share.frames;
+
+            shares.push_back(share);
+        }
+
+        for(auto i = first; i < shares.size(); i++)
+        {
+            auto& share = shares[i];
+            share.configured = total_weight > 0 ? static_cast<double>(share.weight) / total_weight : 0.0;
+            share.achieved = total_frames > 0 ? static_cast<double>(share.frames) / total_frames : 0.0;
+        }
+    }
+
+    return shares;
+}
+
+template <typename T>
+std::vector<source_cache_stats> basic_detection_service<T>::get_cache_stats()
+{
+    const auto snapshot = std::atomic_load(&sources);
+
+    std::vector<source_cache_stats> stats;
+
+    for(const auto& [id, lane]: *snapshot)
+    {
+        if(!lane->cache)
+            continue;
+
+        source_cache_stats cache{};
+        cache.id = id;
+        cache.lookups = lane->cache->get_lookups();
+        cache.hits = lane->cache->get_hits();
+        cache.hit_rate = cache.lookups > 0 ? static_cast<double>(cache.hits) / cache.lookups : 0.0;
+
+        stats.push_back(cache);
+    }
+
+    return stats;
+}
+
+template <typename T>
+bool basic_detection_service<T>::try_add_to_queue(const unsigned source_id, std::shared_ptr<T> frame, frame_clock::time_point origin, frame_trace trace, std::uint64_t content, float scale)
+{
+    const auto snapshot = std::atomic_load(&sources);
+
+    auto it = snapshot->find(source_id);
+    if(it == snapshot->end())
         return false;
 
-    if(queues[source_id].size() >= max_size_per_que)
+    auto& lane = *it->second;
+    trace.source_id = source_id;
+
+    frame_key key;
+    key.content = content;
+
+    // near-duplicate of a recently analysed frame, opt-in - the 64-bit hash misses small changes of the scene
+    if(lane.cache && frame && lane.options.near_duplicate_distance > 0)
+    {
+        key.perceptual = result_cache::perceptual_hash(*frame);
+        key.has_perceptual = true;
+
+        if(auto cached = lane.cache->find_similar(key.perceptual))
+        {
+            result_info info;
+            info.cached = true;
+
+            return this->try_add_answer(source_id, std::move(frame), std::make_shared<const cached_result>(std::move(*cached)), info, origin, trace);
+        }
+    }
+
+    // unchanged scene - answer with the last detections instead of running the model
+    if(lane.motion && frame)
+    {
+        std::vector<detection> reused;
+        std::shared_ptr<const class_table> classes;
+        std::chrono::milliseconds age{0};
+
+        if(lane.motion->try_reuse(*frame, trace.frame_id, frame_clock::now(), reused, classes, age))
+        {
+            lane.carried_over++;
+            total_carried_over_frames++;
+
+            return this->try_add_answer(source_id, std::move(frame), std::make_shared<const cached_result>(cached_result{ std::move(reused), classes }), result_info{ true, age.count() }, origin, trace);
+        }
+    }
+
+    trace.start(trace_stage::queue_wait);
+
+    queued_frame<T> queued{ std::move(frame), origin, trace };
+    queued.key = key;
+    queued.scale = scale;
+
+    // tracked sources send every N-th frame (or the next one once the tracks got unsure) to the detector
+    if(lane.tracker)
+    {
+        queued.detect = lane.tracker->wants_detection() || ++lane.since_keyframe >= lane.options.detect_every;
+
+        if(queued.detect)
+            lane.since_keyframe = 0;
+    }
+
+    return this->enqueue(lane, std::move(queued));
+}
+
+template <typename T>
+bool basic_detection_service<T>::try_add_answer(const unsigned source_id, std::shared_ptr<T> frame, std::shared_ptr<const cached_result> answer, result_info info, frame_clock::time_point origin, frame_trace trace)
+{
+    const auto snapshot = std::atomic_load(&sources);
+
+    auto it = snapshot->find(source_id);
+    if(it == snapshot->end())
+        return false;
+
+    auto& lane = *it->second;
+    trace.source_id = source_id;
+    trace.start(trace_stage::queue_wait);
+
+    // takes no model slot, it waits in the lane only to be published after the frames received before it
+    queued_frame<T> queued{ std::move(frame), origin, trace };
+    queued.detect = false;
+    queued.answer = std::move(answer);
+    queued.info = info;
+
+    // the cached detections refresh the tracks like a keyframe
+    if(lane.tracker)
+        lane.since_keyframe = 0;
+
+    return this->enqueue(lane, std::move(queued));
+}
+
+template <typename T>
+bool basic_detection_service<T>::enqueue(source_lane<T>& lane, queued_frame<T> queued)
+{
+    auto& group = *groups[lane.group];
+
+    if(lane.frames.try_push(queued)) {
+        group.strategy->frame_enqueued(lane);
+        group.work.post();
+        return true;
+    }
+
+    lane.dropped++;
+    total_overflow_frames++;
+
+    if(lane.options.on_overflow != overflow_policy::drop_oldest)
+        return false;
+
+    queued_frame<T> evicted;
+
+    {
+        // the ingest thread briefly becomes a consumer of its lane, only the lane lock - never the scheduler
+        std::lock_guard lock(lane.consumer_mutex);
+
+        if(lane.frames.try_pop(evicted))
+            group.work.consume(1);
+    }
+
+    if(!lane.frames.try_push(queued))
         return false;
-    
-    std::lock_guard lock(que_mutexes[source_id]);
-    queues[source_id].push(frame);
+
+    group.strategy->frame_enqueued(lane);
+    group.work.post();
 
     return true;
 }
 
+template <typename T>
+bool basic_detection_service<T>::admit_frame(const unsigned source_id)
+{
+    const auto snapshot = std::atomic_load(&sources);
+
+    auto it = snapshot->find(source_id);
+    if(it == snapshot->end())
+        return true;
+
+    auto& lane = *it->second;
+
+    if(lane.admission.admit())
+        return true;
+
+    lane.skipped++;
+    total_skipped_frames++;
+
+    return false;
+}
+
 template <typename T>
 bool basic_detection_service<T>::add_to_queue(const unsigned source_id, std::shared_ptr<T> frame)
 {
@@ -83,68 +499,603 @@ bool basic_detection_service<T>::add_to_queue(const unsigned source_id, std::sha
 
 template <typename T>
 bool basic_detection_service<T>::contains(int source_id) {
-    return queues.find(source_id) != queues.end();
+    const auto snapshot = std::atomic_load(&sources);
+    return snapshot->find(source_id) != snapshot->end();
 }
 
 template <typename T>
 void basic_detection_service<T>::run()
 {
-    unsigned current_queue_id = 0;
-    
-    while (true)
+    if(models.empty())
+        throw std::runtime_error("[Detection service]: No model to run inference with");
+
+    {
+        std::lock_guard lock(metrics_mutex);
+        performance_meters = std::vector<replica_metrics>(models.size());
+    }
+
+    const unsigned workers = pipeline_threads > 0 ? pipeline_threads : std::max(1u, std::thread::hardware_concurrency() / 2);
+    pool = std::make_unique<task_pool>(workers);
+    pool_workers = pool->size();
+
+    // a model degrades only as far as every one of its replicas can follow
+    for(auto& group: groups)
+    {
+        std::size_t levels = 1 + degraded_models.at(group->replicas.front()).size();
+        for(auto replica: group->replicas)
+            levels = std::min(levels, 1 + degraded_models.at(replica).size());
+
+        const auto first = group->replicas.front();
+
+        group->resolutions.clear();
+        group->resolutions.push_back(models[first]->get_input_shape());
+
+        for(std::size_t level = 1; level < levels; level++)
+            group->resolutions.push_back(degraded_models[first][level - 1]->get_input_shape());
+    }
+
+    for(std::size_t i = 0; i < models.size(); i++)
     {
-        try{
-            if(queues.empty())
+        auto pipeline = std::make_unique<replica_pipeline>();
+        pipeline->index = i;
+        pipeline->model = models[i].get();
+
+        for(auto& group: groups)
+            if(std::find(group->replicas.begin(), group->replicas.end(), i) != group->replicas.end())
+                pipeline->group = group.get();
+
+        pipeline->levels.push_back(pipeline->model);
+        for(std::size_t level = 1; level < pipeline->group->resolutions.size(); level++)
+            pipeline->levels.push_back(degraded_models[i][level - 1].get());
+
+        for(unsigned d = 0; d < pipeline_depth; d++)
+        {
+            auto job = std::make_unique<pipeline_job>();
+            job->pipeline = pipeline.get();
+
+            for(auto* level: pipeline->levels)
+                job->inferences.push_back(level->create_job());
+
+            job->model = pipeline->model;
+            job->inference = job->inferences.front().get();
+
+            pipeline->free_jobs.push(job.get());
+            pipeline->jobs.push_back(std::move(job));
+        }
+
+        pipelines.push_back(std::move(pipeline));
+    }
+
+    spdlog::info("[Detection service]: {} replica(s), {} pipeline thread(s), {} batch(es) in flight per replica", models.size(), pool->size(), pipeline_depth);
+
+    for(const auto& group: groups)
+    {
+        std::string resolutions;
+        for(const auto& shape: group->resolutions)
+            resolutions += (resolutions.empty() ? "" : ", ") + std::to_string(shape.width) + "x" + std::to_string(shape.height);
+
+        spdlog::info("[Detection service]: Model '{}' \t{} replica(s) \tresolutions {}", group->name, group->replicas.size(), resolutions);
+    }
+
+    std::vector<std::thread> threads;
+    for(std::size_t i = 0; i < models.size(); i++)
+        threads.emplace_back([this, i](){ this->run_forward(i); });
+
+    for(std::size_t i = 1; i < models.size(); i++)
+        threads.emplace_back([this, i](){ this->run_replica(i); });
+
+    this->run_replica(0);
+
+    for(auto& thread: threads)
+        thread.join();
+}
+
+template <typename T>
+void basic_detection_service<T>::record_stage(pipeline_stage stage, double ms)
+{
+    auto& meter = stages[static_cast<std::size_t>(stage)];
+    meter.busy_us += static_cast<unsigned long long>(ms * 1000.0);
+    meter.jobs++;
+}
+
+template <typename T>
+std::vector<stage_report> basic_detection_service<T>::get_stage_metrics()
+{
+    const auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(frame_clock::now() - started).count();
+
+    std::vector<stage_report> reports;
+    reports.reserve(pipeline_stage_count);
+
+    for(std::size_t i = 0; i < pipeline_stage_count; i++)
+    {
+        const auto stage = static_cast<pipeline_stage>(i);
+        const auto& meter = stages[i];
+
+        // forward runs on one thread per replica, the rest shares the task pool
+        const double workers = stage == pipeline_stage::forward ? models.size() : std::max(1u, pool_workers.load());
+
+        stage_report report;
+        report.stage = stage;
+        report.depth = meter.depth;
+        report.jobs = meter.jobs;
+        report.utilisation = elapsed_us > 0 ? meter.busy_us / (elapsed_us * workers) : 0.0;
+        report.avg_ms = report.jobs > 0 ? meter.busy_us / 1000.0 / report.jobs : 0.0;
+
+        reports.push_back(report);
+    }
+
+    return reports;
+}
+
+template <typename T>
+bool basic_detection_service<T>::gather(replica_pipeline& pipeline, pipeline_job& job)
+{
+    const unsigned batch_size = pipeline.model->get_max_batch_size();
+    auto& group = *pipeline.group;
+
+    job.sources.clear();
+    job.frames.clear();
+    job.batch.clear();
+    job.regions.clear();
+    job.slots.clear();
+    job.traces.clear();
+    job.keys.clear();
+    job.scales.clear();
+    job.answers.clear();
+    job.infos.clear();
+    job.timeline = {};
+
+    const auto tile = pipeline.model->get_input_shape();
+
+    std::lock_guard schedule_lock(group.schedule_mutex);
+
+    const auto lanes = std::atomic_load(&group.sources);
+    const auto now = frame_clock::now();
+
+    this->adapt_resolution(group, *lanes, batch_size, now);
+
+    // sources with frames in flight on another replica are skipped to keep their frames in order,
+    // frames of the same replica are published in gathering order anyway
+    auto& blocked = pipeline.blocked;
+    blocked.clear();
+    for(const auto& [id, source_flight]: group.in_flight_sources)
+        if(source_flight.replica != pipeline.index)
+            blocked.insert(id);
+
+    // tracked-only frames take no slot, they are cheap but the job is bounded anyway
+    const std::size_t max_frames = 4 * static_cast<std::size_t>(batch_size);
+
+    // the batch runs at the resolution of the first frame taking a slot
+    std::optional<std::size_t> batch_level;
+
+    // gather up to batch_size slots, stop once every lane turned out to be empty
+    std::size_t empty_in_row = 0;
+    while(job.batch.size() < batch_size && job.frames.size() < max_frames && !lanes->empty() && empty_in_row < lanes->size())
+    {
+        const auto id = group.current_queue_id = group.strategy->choose_next_queue(*lanes, group.current_queue_id, blocked);
+        auto& lane = *lanes->at(id);
+
+        std::vector<cv::Rect> regions;
+
+        // tiles are cut to the full input shape, tiled sources are never degraded
+        const std::size_t level = lane.options.tiled ? 0 : std::min(lane.level.load(), group.resolutions.size() - 1);
+
+        queued_frame<T> queued;
+        bool popped = false;
+
+        {
+            // the producer may evict the oldest frame on overflow, the peek and the pop stay under the lane lock
+            std::lock_guard lane_lock(lane.consumer_mutex);
+
+            const auto* next = blocked.count(id) ? nullptr : lane.frames.front();
+            const bool detect_next = next && next->frame && next->detect;
+
+            // a tiled frame needs a slot per tile, it waits for the next batch when the rest of this one is too small
+            if(lane.options.tiled && detect_next)
             {
-                //std::this_thread::sleep_for(sleep_on_empty);
-                std::this_thread::yield();
-                continue;
+                regions = tiling::plan(cv::Size(next->frame->cols, next->frame->rows), tile, lane.options.tile_overlap, lane.options.global_view, batch_size);
+
+                if(job.batch.size() + regions.size() > batch_size)
+                    blocked.insert(id);
             }
 
-            std::lock_guard inf_lock(inference_mutex);
+            // a frame at another resolution waits for the next batch
+            if(detect_next && batch_level.has_value() && *batch_level != level)
+                blocked.insert(id);
 
-            current_queue_id = strategy->choose_next_queue(this->queues, current_queue_id);
+            popped = !blocked.count(id) && lane.frames.try_pop(queued);
+        }
 
-            if(queues.empty() || queues.at(current_queue_id).empty())
-                continue;
+        if(!popped) {
+            ++empty_in_row;
+            continue;
+        }
 
-            performance_meter.start();
+        empty_in_row = 0;
+        group.work.consume(1);
+
+        // a result past the budget is of no use to the source, spend the inference on fresher frames
+        if(lane.is_expired(queued.origin, now)) {
+            lane.expired++;
+            total_expired_frames++;
+            continue;
+        }
+
+        auto frame_ptr = std::move(queued.frame);
+
+        // frames answered before decoding have no frame, only their detections
+        if(!frame_ptr && !queued.answer) 
+            continue;
+
+        queued.trace.stop(trace_stage::queue_wait, now);
+
+        lane.served++;
+        job.sources.push_back(id);
+        job.frames.push_back(frame_ptr);
+        job.traces.push_back(queued.trace);
+        job.keys.push_back(queued.key);
+        job.scales.push_back(queued.scale);
+        job.answers.push_back(std::move(queued.answer));
+        job.infos.push_back(queued.info);
+
+        if(!queued.detect) {
+            job.slots.push_back(0);
+            continue;
+        }
+
+        batch_level = level;
+
+        if(regions.size() > 1)
+        {
+            // tiles are views into the frame, nothing is copied until preprocessing
+            for(const auto& region: regions) {
+                job.batch.push_back(T(*frame_ptr, region));
+                job.regions.push_back(region);
+            }
+
+            job.slots.push_back(regions.size());
+            continue;
+        }
+
+        job.batch.push_back(*frame_ptr);
+        job.regions.emplace_back(0, 0, frame_ptr->cols, frame_ptr->rows);
+        job.slots.push_back(1);
+    }
+
+    for(auto id: job.sources)
+    {
+        auto& source_flight = group.in_flight_sources[id];
+        source_flight.replica = pipeline.index;
+        source_flight.frames++;
+    }
+
+    job.level = batch_level.value_or(0);
+    job.model = pipeline.levels.at(job.level);
+    job.inference = job.inferences.at(job.level).get();
+
+    // never shrinks, the lists keep their capacity for the next larger job
+    if(job.merged.size() < job.frames.size())
+        job.merged.resize(job.frames.size());
+    job.gathered = now;
+
+    return !job.frames.empty();
+}
+
+template <typename T>
+void basic_detection_service<T>::adapt_resolution(model_group& group, const source_table<T>& lanes, std::size_t batch_size, frame_clock::time_point now)
+{
+    if(group.resolutions.size() < 2 || now < group.next_adaptation)
+        return;
 
-            auto frame_ptr = queues[current_queue_id].front(); // fetch
+    group.next_adaptation = now + adaptation_interval;
 
-            if(!frame_ptr) 
+    std::size_t queued = 0;
+    unsigned long long dropped = 0;
+    frame_clock::duration oldest{0};
+
+    for(const auto& [id, lane]: lanes)
+    {
+        queued += lane->frames.size();
+        dropped += lane->dropped;
+
+        std::lock_guard lane_lock(lane->consumer_mutex);
+
+        if(const auto* head = lane->frames.front())
+            oldest = std::max(oldest, now - head->trace.begin[frame_trace::index(trace_stage::queue_wait)]);
+    }
+
+    const auto overflowed = dropped - std::min(dropped, group.seen_dropped);
+    group.seen_dropped = dropped;
+
+    // backlog in batches the replicas of the model take at once
+    const std::size_t capacity = std::max<std::size_t>(1, batch_size * group.replicas.size());
+
+    const bool overloaded = overflowed > 0 || queued > 2 * capacity || oldest > degrade_latency;
+    const bool relaxed = 2 * queued <= capacity && oldest < degrade_latency / 2;
+
+    group.relaxed_checks = relaxed ? group.relaxed_checks + 1 : 0;
+
+    const auto max_level = group.resolutions.size() - 1;
+
+    // a batch runs at a single resolution, a whole priority class steps at once so its sources stay batchable together
+    std::optional<unsigned> priority;
+    std::size_t level = 0;
+
+    if(overloaded)
+    {
+        // lowest priority first, from the least degraded source of the class one level down
+        for(const auto& [id, lane]: lanes)
+        {
+            if(lane->options.tiled || lane->level >= max_level)
                 continue;
-            
-            auto results = model->object_detection(*frame_ptr);
-            
-            ++total_frames_processed;
 
-            auto processing = processing_service::get_service_instance();
-            processing->push_results(current_queue_id, frame_ptr, results);
-        
-            performance_meter.stop();
+            if(!priority || lane->options.priority < *priority) {
+                priority = lane->options.priority;
+                level = lane->level;
+            }
+            else if(lane->options.priority == *priority)
+                level = std::min(level, lane->level.load());
+        }
 
-            if(total_frames_processed == 1)
-                performance_meter.reset();
+        level++;
+    }
+    else if(group.relaxed_checks >= relaxed_checks_to_step_up)
+    {
+        // the other way round - highest priority first, from the most degraded source of the class one level up
+        for(const auto& [id, lane]: lanes)
+        {
+            if(lane->level == 0)
+                continue;
 
-            if(total_frames_processed % (int(performance_meter.getFPS())+1) == 0)
-            {
-                spdlog::debug(
-                    "que: {} \tque size: {} \tavg: {:.2f}ms \t{:.2f}fps \t{} frames \tques: {}", 
-                    current_queue_id, 
-                    queues[current_queue_id].size(), 
-                    performance_meter.getAvgTimeMilli(), 
-                    performance_meter.getFPS(),
-                    total_frames_processed,
-                    queues.size());
+            if(!priority || lane->options.priority > *priority) {
+                priority = lane->options.priority;
+                level = lane->level;
             }
+            else if(lane->options.priority == *priority)
+                level = std::max(level, lane->level.load());
+        }
+
+        level--;
+    }
+
+    if(!priority)
+        return;
+
+    if(!overloaded)
+        group.relaxed_checks = 0;
+
+    std::size_t stepped = 0;
+
+    for(const auto& [id, lane]: lanes)
+    {
+        if(lane->options.tiled || lane->options.priority != *priority)
+            continue;
 
-            std::unique_lock lock(que_mutexes[current_queue_id]); // <-- locking queue
-            queues[current_queue_id].pop(); // remove front position
-            lock.unlock(); // unlock the queue
+        // sources of the class already past the level catch up with it, the others stay
+        if(overloaded ? lane->level < level : lane->level > level) {
+            lane->level = level;
+            stepped++;
         }
-        catch(const cv::Exception& e) {
+    }
+
+    const auto& shape = group.resolutions[level];
+
+    spdlog::info(
+        "[Detection service]: {} source(s) of priority {} analysed at {}x{} \t{} queued \t{} overflowed \t{:.1f}ms oldest", 
+        stepped, 
+        *priority, 
+        shape.width, 
+        shape.height, 
+        queued, 
+        overflowed, 
+        std::chrono::duration<double, std::milli>(oldest).count());
+}
+
+template <typename T>
+void basic_detection_service<T>::run_replica(std::size_t replica)
+{
+    auto& pipeline = *pipelines.at(replica);
+
+    while (true)
+    {
+        // every job of the replica is in flight - wait for the oldest one to be published
+        auto* job = pipeline.free_jobs.pop();
+
+        bool gathered = false;
+
+        while(!gathered)
+        {
+            try{
+                // read before looking for work, so a frame posted meanwhile is not missed
+                const auto seen_version = pipeline.group->work.current_version();
+
+                gathered = this->gather(pipeline, *job);
+
+                if(gathered)
+                    break;
+
+                // nothing runnable - block until a frame arrives or a busy source is released
+                cv::TickMeter idle_meter;
+                idle_meter.start();
+                const auto wake_up = pipeline.group->work.wait(seen_version);
+                idle_meter.stop();
+
+                std::lock_guard metrics_lock(metrics_mutex);
+                auto& metrics = performance_meters[replica];
+                metrics.idle_ms += idle_meter.getTimeMilli();
+
+                if(wake_up.count() > 0) {
+                    metrics.wake_ups += 1;
+                    metrics.wake_up_us += wake_up.count();
+                }
+            }
+            catch(const std::exception& e) {
+                spdlog::error(e.what());
+            }
+            catch(...) {
+                spdlog::error("[Detection service]: Unknown Error");
+            }
+        }
+
+        job->sequence = pipeline.next_sequence++;
+        job->failed = false;
+
+        // tracked-only frames - nothing for the model, publish in order right away
+        if(job->batch.empty()) {
+            this->finish(*job);
+            continue;
+        }
+
+        stages[static_cast<std::size_t>(pipeline_stage::preprocess)].depth++;
+        pool->submit([this, job]() { this->run_preprocess(*job); });
+    }
+}
+
+template <typename T>
+void basic_detection_service<T>::run_preprocess(pipeline_job& job)
+{
+    stages[static_cast<std::size_t>(pipeline_stage::preprocess)].depth--;
+
+    // a job that never reaches finish() leaves a hole in the publish sequence and wedges the replica
+    bool forwarded = false;
+    scope_exit finish_unless_forwarded{ [&]() { if(!forwarded) this->finish(job); } };
+
+    cv::TickMeter meter;
+    meter.start();
+    job.timeline.start(trace_stage::preprocess);
+
+    try {
+        job.model->preprocess(job.batch.data(), job.batch.size(), *job.inference);
+    }
+    catch(const std::exception& e) {
+        spdlog::error(e.what());
+        job.failed = true;
+    }
+    catch(...) {
+        spdlog::error("[Detection service]: Unknown Error");
+        job.failed = true;
+    }
+
+    job.timeline.stop(trace_stage::preprocess);
+    meter.stop();
+    this->record_stage(pipeline_stage::preprocess, meter.getTimeMilli());
+
+    if(job.failed)
+        return;
+
+    stages[static_cast<std::size_t>(pipeline_stage::forward)].depth++;
+    job.pipeline->forward_queue.push(&job);
+    forwarded = true;
+}
+
+template <typename T>
+void basic_detection_service<T>::run_forward(std::size_t replica)
+{
+    auto& pipeline = *pipelines.at(replica);
+
+    if(threads_per_replica > 0)
+        cv::setNumThreads(threads_per_replica);
+
+    spdlog::info("[Detection service]: Replica {} started", replica);
+
+    while (true)
+    {
+        auto* job = pipeline.forward_queue.pop();
+        stages[static_cast<std::size_t>(pipeline_stage::forward)].depth--;
+
+        cv::TickMeter meter;
+        meter.start();
+        job->timeline.start(trace_stage::forward);
+
+        try {
+            // variants of the replica share its thread, their forward passes are serialised too
+            job->model->forward(*job->inference);
+        }
+        catch(const std::exception& e) {
             spdlog::error(e.what());
+            job->failed = true;
+        }
+        catch(...) {
+            spdlog::error("[Detection service]: Unknown Error");
+            job->failed = true;
+        }
+
+        job->timeline.stop(trace_stage::forward);
+        meter.stop();
+        this->record_stage(pipeline_stage::forward, meter.getTimeMilli());
+
+        {
+            std::lock_guard metrics_lock(metrics_mutex);
+            performance_meters[replica].busy_ms += meter.getTimeMilli();
+        }
+
+        if(job->failed) {
+            this->finish(*job);
+            continue;
+        }
+
+        stages[static_cast<std::size_t>(pipeline_stage::postprocess)].depth++;
+        pool->submit([this, job]() { this->run_postprocess(*job); });
+    }
+}
+
+template <typename T>
+void basic_detection_service<T>::run_postprocess(pipeline_job& job)
+{
+    stages[static_cast<std::size_t>(pipeline_stage::postprocess)].depth--;
+
+    // published or not, the job has to take its turn in the publish sequence
+    scope_exit finish_job{ [&]() { this->finish(job); } };
+
+    cv::TickMeter meter;
+    meter.start();
+    job.timeline.start(trace_stage::postprocess);
+
+    try {
+        job.model->postprocess(*job.inference);
+
+        // map the tiles of tiled frames back to the frame and drop the duplicates across tile borders
+        const auto params = job.model->get_nms_params();
+
+        for(std::size_t i = 0, slot = 0; i < job.frames.size(); slot += job.slots[i], i++)
+            if(job.slots[i] > 1)
+                tiling::merge(&job.inference->results.at(slot), &job.regions.at(slot), job.slots[i], params, job.merged[i], job.inference->workspace);
+    }
+    catch(const std::exception& e) {
+        spdlog::error(e.what());
+        job.failed = true;
+    }
+    catch(...) {
+        spdlog::error("[Detection service]: Unknown Error");
+        job.failed = true;
+    }
+
+    job.timeline.stop(trace_stage::postprocess);
+    meter.stop();
+    this->record_stage(pipeline_stage::postprocess, meter.getTimeMilli());
+}
+
+template <typename T>
+void basic_detection_service<T>::finish(pipeline_job& job)
+{
+    auto& pipeline = *job.pipeline;
+
+    stages[static_cast<std::size_t>(pipeline_stage::publish)].depth++;
+
+    std::lock_guard lock(pipeline.publish_mutex);
+    pipeline.finished.emplace(job.sequence, &job);
+
+    while(!pipeline.finished.empty() && pipeline.finished.begin()->first == pipeline.next_publish)
+    {
+        auto* next = pipeline.finished.begin()->second;
+        pipeline.finished.erase(pipeline.finished.begin());
+        pipeline.next_publish++;
+
+        stages[static_cast<std::size_t>(pipeline_stage::publish)].depth--;
+
+        // publish() returns the job to the free list whichever way it ends, a throw must not stop the jobs queued behind it
+        try {
+            this->publish(*next);
         }
         catch(const std::exception& e) {
             spdlog::error(e.what());
@@ -152,17 +1103,260 @@ void basic_detection_service<T>::run()
         catch(...) {
             spdlog::error("[Detection service]: Unknown Error");
         }
-    }   
+    }
+}
+
+template <typename T>
+void basic_detection_service<T>::publish(pipeline_job& job)
+{
+    auto& pipeline = *job.pipeline;
+    auto& model = *pipeline.model;
+    const auto replica = pipeline.index;
+
+    // back to the free list when done, also when something below throws
+    scope_exit recycle{ [&]() { pipeline.free_jobs.push(&job); } };
+
+    cv::TickMeter meter;
+    meter.start();
+
+    if(!job.failed)
+    {
+        auto processing = processing_service::get_service_instance();
+        const auto classes = model.get_class_table();
+        const auto lanes = std::atomic_load(&pipeline.group->sources);
+        for(std::size_t i = 0, slot = 0; i < job.frames.size(); slot += job.slots[i], i++)
+        {
+            // a frame that fails to publish must not take the rest of the batch, or the job slot, with it
+            try
+            {
+                auto& trace = job.traces[i];
+                auto& detections = job.slots[i] == 1 ? job.inference->results.at(slot) : job.merged[i];
+                auto frame_classes = classes;
+
+                const auto it = lanes->find(job.sources[i]);
+                auto* lane = it != lanes->end() ? it->second.get() : nullptr;
+
+                result_info info = job.infos[i];
+
+                // frames of a source are published in order, so the tracker sees them in order too
+                if(job.answers[i])
+                {
+                    detections = job.answers[i]->detections;
+                    frame_classes = job.answers[i]->classes;
+
+                    if(lane && lane->tracker)
+                        lane->tracker->update(detections);
+
+                    if(info.cached)
+                        total_cached_frames++;
+                }
+                else if(job.slots[i] == 0)
+                {
+                    detections.clear();
+
+                    if(lane && lane->tracker)
+                        lane->tracker->predict(detections);
+
+                    info.predicted = true;
+                    total_predicted_frames++;
+
+                    if(lane)
+                        lane->predicted++;
+                }
+                else
+                {
+                    trace.copy(trace_stage::preprocess, job.timeline);
+                    trace.copy(trace_stage::forward, job.timeline);
+                    trace.copy(trace_stage::postprocess, job.timeline);
+
+                    const auto& shape = pipeline.group->resolutions.at(job.level);
+                    info.input_width = shape.width;
+                    info.input_height = shape.height;
+
+                    if(job.level > 0)
+                        total_degraded_frames++;
+
+                    // frames decoded at a reduced scale - boxes back to source pixels before anything keeps them
+                    if(job.scales[i] != 1.0f)
+                    {
+                        for(auto& box: detections)
+                        {
+                            box.x *= job.scales[i];
+                            box.y *= job.scales[i];
+                            box.width *= job.scales[i];
+                            box.height *= job.scales[i];
+                        }
+                    }
+
+                    if(lane && lane->tracker)
+                        lane->tracker->update(detections);
+
+                    if(lane && lane->motion)
+                        lane->motion->analysed(trace.frame_id, detections, classes);
+
+                    if(lane && lane->cache && (job.keys[i].content != 0 || job.keys[i].has_perceptual))
+                        lane->cache->store(job.keys[i], detections, classes);
+                }
+
+                processing->push_results(job.sources[i], job.frames[i], detections, frame_classes, trace, info);
+            }
+            catch(const std::exception& e) {
+                spdlog::error(e.what());
+            }
+            catch(...) {
+                spdlog::error("[Detection service]: Unknown Error");
+            }
+        }
+    }
+
+    meter.stop();
+    this->record_stage(pipeline_stage::publish, meter.getTimeMilli());
+
+    {
+        auto& group = *pipeline.group;
+
+        std::lock_guard schedule_lock(group.schedule_mutex);
+        for(auto id: job.sources)
+        {
+            auto it = group.in_flight_sources.find(id);
+            if(it != group.in_flight_sources.end() && --it->second.frames == 0)
+                group.in_flight_sources.erase(it);
+        }
+    }
+
+    // frames of these sources may be waiting for them
+    pipeline.group->work.release();
+
+    // frames that went through the model, tracked-only frames are counted separately
+    const std::size_t frames = job.failed ? 0 : static_cast<std::size_t>(std::count_if(job.slots.begin(), job.slots.end(), [](std::size_t slots) { return slots > 0; }));
+    const auto processed = total_frames_processed += frames;
+    const auto latency = std::chrono::duration<double, std::milli>(frame_clock::now() - job.gathered).count();
+    const auto last_source = job.sources.back();
+
+    // drop the frame references right away, the job waits in the free list
+    job.frames.clear();
+    job.batch.clear();
+    job.answers.clear();
+
+    // every resolution level of the job has its own workspace
+    unsigned long long growth_events = 0;
+    for(const auto& inference: job.inferences)
+        growth_events += inference->workspace.growth_events;
+
+    {
+        std::lock_guard metrics_lock(metrics_mutex);
+        auto& metrics = performance_meters[replica];
+
+        if(frames > 0 && processed != frames) // skip the first (warm up) batch
+        {
+            // steady state should not allocate, report every time the workspace still had to grow
+            if(growth_events != job.growth_events)
+                spdlog::debug("replica: {} \tinference workspace grew ({} growth events so far)", replica, growth_events);
+
+            metrics.latency_ms += latency;
+            metrics.batches += 1;
+            metrics.frames += frames;
+        }
+
+        job.growth_events = growth_events;
+
+        const auto fps = metrics.busy_ms > 0.0 ? metrics.frames / (metrics.busy_ms / 1000.0) : 0.0;
+
+        if(frames > 0 && metrics.batches % (static_cast<unsigned long long>(fps)+1) == 0)
+        {
+            spdlog::debug(
+                "replica: {} ({}) \tque: {} \tbatch: {} \t{:.2f}ms \t{:.2f}fps \t{} frames \tques: {}", 
+                replica,
+                pipeline.group->name,
+                last_source, 
+                frames,
+                latency, 
+                fps,
+                processed,
+                std::atomic_load(&pipeline.group->sources)->size());
+        }
+    }
 }
 
 
 template <typename T>
-bool basic_detection_service<T>::visit_new_src(unsigned src_id) 
+bool basic_detection_service<T>::visit_new_src(const source_options& options) 
 {   
     auto metrics = this->get_performance();
-    spdlog::info("[Service Metrics]: {}ms \t{} fps", metrics.avgProcessingTime, metrics.avgFPS);
+    spdlog::info(
+        "[Service Metrics]: {}ms \t{} fps \t{:.1f}% idle \t{:.1f}us wake-up \t{} expired \t{} skipped \t{} overflowed \t{} carried over \t{} predicted \t{} cached \t{} degraded ({} sources)", 
+        metrics.avgProcessingTime, 
+        metrics.avgFPS, 
+        metrics.idleRatio * 100.0, 
+        metrics.avgWakeUpMicros,
+        metrics.expiredFrames,
+        metrics.skippedFrames,
+        metrics.droppedFrames,
+        metrics.carriedOverFrames,
+        metrics.predictedFrames,
+        metrics.cachedFrames,
+        metrics.degradedFrames,
+        metrics.degradedSources);
+
+    for(const auto& share: this->get_source_shares())
+    {
+        spdlog::debug(
+            "[Service Metrics]: source {} \tweight {} \tconfigured {:.1f}% \tachieved {:.1f}% \t{} frames", 
+            share.id, 
+            share.weight, 
+            share.configured * 100.0, 
+            share.achieved * 100.0, 
+            share.frames);
+    }
 
-    return this->register_source(src_id);
+    for(const auto& cache: this->get_cache_stats())
+    {
+        spdlog::debug(
+            "[Service Metrics]: source {} \tcache hit rate {:.1f}% \t{} of {} frames", 
+            cache.id, 
+            cache.hit_rate * 100.0, 
+            cache.hits, 
+            cache.lookups);
+    }
+
+    for(const auto& stage: this->get_stage_metrics())
+    {
+        spdlog::debug(
+            "[Service Metrics]: {} \tdepth {} \t{:.1f}% busy \t{:.2f}ms avg \t{} batches", 
+            to_string(stage.stage), 
+            stage.depth, 
+            stage.utilisation * 100.0, 
+            stage.avg_ms, 
+            stage.jobs);
+    }
+
+    for(const auto& latency: trace_recorder::get_instance().get_latencies())
+    {
+        if(latency.count == 0)
+            continue;
+
+        spdlog::debug(
+            "[Service Metrics]: {} \tp50 {}us \tp99 {}us \tp999 {}us \tmax {}us", 
+            latency.stage, 
+            latency.p50, 
+            latency.p99, 
+            latency.p999, 
+            latency.max);
+    }
+
+    for(const auto& pool: frame_pool::get_instance().get_stats())
+    {
+        spdlog::debug(
+            "[Service Metrics]: frame pool {:.2f}MB \t{} in use of {} \thigh water {} \t{} acquired \t{} allocated", 
+            pool.slab_bytes / 1048576.0, 
+            pool.in_use, 
+            pool.slabs, 
+            pool.high_water, 
+            pool.acquired, 
+            pool.allocations);
+    }
+
+    return this->register_source(options);
 }
 
 template <typename T>
@@ -171,40 +1365,256 @@ bool basic_detection_service<T>::visit_obsolete_src(unsigned src_id){
 }
 
 template <typename T>
-bool basic_detection_service<T>::visit_new_frame(unsigned src_id, std::shared_ptr<T> frame) {
-    return this->try_add_to_queue(src_id, frame);
+bool basic_detection_service<T>::visit_frame_age(unsigned src_id, std::chrono::milliseconds age) {
+    const auto snapshot = std::atomic_load(&sources);
+
+    auto it = snapshot->find(src_id);
+    if(it == snapshot->end())
+        return true;
+
+    auto& lane = *it->second;
+    const auto now = frame_clock::now();
+
+    if(!lane.is_expired(now - age, now))
+        return true;
+
+    lane.expired++;
+    total_expired_frames++;
+
+    return false;
+}
+
+template <typename T>
+bool basic_detection_service<T>::visit_frame_admission(unsigned src_id) {
+    return this->admit_frame(src_id);
+}
+
+template <typename T>
+bool basic_detection_service<T>::visit_cache_enabled(unsigned src_id) {
+    const auto snapshot = std::atomic_load(&sources);
+
+    auto it = snapshot->find(src_id);
+    return it != snapshot->end() && it->second->cache;
 }
 
 template <typename T>
-unsigned prioritize_load_strategy<T>::choose_next_queue(std::map<unsigned, std::queue<std::shared_ptr<T>>>& q, unsigned current_queue_id)
+std::shared_ptr<const cached_result> basic_detection_service<T>::visit_frame_content(unsigned src_id, std::uint64_t content) {
+    const auto snapshot = std::atomic_load(&sources);
+
+    auto it = snapshot->find(src_id);
+    if(it == snapshot->end() || !it->second->cache)
+        return nullptr;
+
+    auto cached = it->second->cache->find_content(content);
+    if(!cached)
+        return nullptr;
+
+    return std::make_shared<const cached_result>(std::move(*cached));
+}
+
+template <typename T>
+bool basic_detection_service<T>::visit_cached_frame(unsigned src_id, std::shared_ptr<const cached_result> answer, frame_clock::time_point origin, const frame_trace& trace) {
+    result_info info;
+    info.cached = true;
+
+    // nothing was decoded, the result goes out without a frame
+    return this->try_add_answer(src_id, nullptr, std::move(answer), info, origin, trace);
+}
+
+template <typename T>
+cv::Size basic_detection_service<T>::visit_decode_target(unsigned src_id) {
+    const auto snapshot = std::atomic_load(&sources);
+
+    auto it = snapshot->find(src_id);
+
+    // tiles are cut from the full frame
+    if(it == snapshot->end() || it->second->options.tiled)
+        return cv::Size();
+
+    // models are all added before sources register
+    const auto& group = *groups.at(it->second->group);
+    return models.at(group.replicas.front())->get_input_shape();
+}
+
+template <typename T>
+bool basic_detection_service<T>::visit_new_frame(unsigned src_id, std::shared_ptr<T> frame, frame_clock::time_point origin, const frame_trace& trace, std::uint64_t content, float scale) {
+    return this->try_add_to_queue(src_id, frame, origin, trace, content, scale);
+}
+
+template <typename T>
+unsigned prioritize_load_strategy<T>::choose_next_queue(const source_table<T>& sources, unsigned current_queue_id, const std::unordered_set<unsigned>& busy)
 {
-    /**
-     * It might be root of segfaults
-     * gotta investigate further
-    */
-    auto it = std::max_element(q.begin(), q.end(), 
-    [](const std::pair<unsigned, std::queue<std::shared_ptr<T>>>& q1, const std::pair<unsigned, std::queue<std::shared_ptr<T>>>& q2) -> bool 
+    // the longest lane that can be served, a blocked one would be picked over and over while the others wait
+    auto longest = sources.end();
+
+    for(auto it = sources.begin(); it != sources.end(); ++it)
+    {
+        if(busy.count(it->first))
+            continue;
+
+        if(longest == sources.end() || longest->second->frames.size() < it->second->frames.size())
+            longest = it;
+    }
+
+    if(longest != sources.end())
+        return longest->first;
+
+    if(sources.find(current_queue_id) != sources.end())
+        return current_queue_id;
+
+    return (*sources.begin()).first;
+}
+
+template <typename T>
+unsigned prioritize_order_strategy<T>::choose_next_queue(const source_table<T>& sources, unsigned current_queue_id, const std::unordered_set<unsigned>& busy)
+{
+    auto it = sources.find(current_queue_id);
+
+    // round robin from the current lane, over the lanes that can be served
+    for(std::size_t i = 0; i < sources.size(); i++)
     {
-        return q1.second.size() < q2.second.size();
-    });
+        if(it == sources.end() || ++it == sources.end())
+            it = sources.begin();
+
+        if(!busy.count(it->first))
+            return it->first;
+    }
 
     return (*it).first;
 }
 
 template <typename T>
-unsigned prioritize_order_strategy<T>::choose_next_queue(std::map<unsigned, std::queue<std::shared_ptr<T>>>& q, unsigned current_queue_id)
+unsigned earliest_deadline_strategy<T>::choose_next_queue(const source_table<T>& sources, unsigned current_queue_id, const std::unordered_set<unsigned>& busy)
+{
+    bool found = false;
+    unsigned earliest_id = current_queue_id;
+    frame_clock::time_point earliest{};
+
+    for(const auto& [id, lane]: sources)
+    {
+        if(busy.count(id))
+            continue;
+
+        frame_clock::time_point origin;
+
+        {
+            // the producer may evict the oldest frame meanwhile
+            std::lock_guard lane_lock(lane->consumer_mutex);
+
+            const auto* oldest = lane->frames.front();
+            if(oldest == nullptr)
+                continue;
+
+            origin = oldest->origin;
+        }
+
+        const auto budget = lane->options.staleness_budget.count() > 0 ? lane->options.staleness_budget : default_budget;
+        const auto deadline = origin + budget;
+
+        if(!found || deadline < earliest) {
+            found = true;
+            earliest = deadline;
+            earliest_id = id;
+        }
+    }
+
+    if(found || sources.find(current_queue_id) != sources.end())
+        return earliest_id;
+
+    return (*sources.begin()).first;
+}
+
+template <typename T>
+void weighted_fair_strategy<T>::frame_enqueued(source_lane<T>& lane)
+{
+    // pairs with the fence in choose_next_queue: either the scheduler sees the frame or we see the parked flag
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if(!lane.parked.load(std::memory_order_relaxed) || !lane.parked.exchange(false))
+        return;
+
+    std::lock_guard lock(woken_mutex);
+    woken.push_back(lane.id);
+}
+
+template <typename T>
+void weighted_fair_strategy<T>::activate(unsigned id)
+{
+    auto& source = entries[id];
+
+    if(source.active)
+        return;
+
+    source.active = true;
+    source.pass = std::max(source.pass, virtual_time);
+    active.emplace(source.pass, id);
+}
+
+template <typename T>
+unsigned weighted_fair_strategy<T>::choose_next_queue(const source_table<T>& sources, unsigned current_queue_id, const std::unordered_set<unsigned>& busy)
 {
-    auto it = q.find(current_queue_id);
+    {
+        std::lock_guard lock(woken_mutex);
+        waking.swap(woken);
+    }
+
+    for(auto id: waking)
+        activate(id);
+
+    waking.clear();
+
+    for(auto it = active.begin(); it != active.end();)
+    {
+        const auto [pass, id] = *it;
+        const auto lane_it = sources.find(id);
+
+        if(lane_it == sources.end()) {
+            entries.erase(id);
+            it = active.erase(it);
+            continue;
+        }
+
+        if(busy.count(id)) {
+            ++it;
+            continue;
+        }
+
+        auto& lane = *lane_it->second;
+
+        if(lane.frames.empty())
+        {
+            lane.parked.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            // a frame that raced with parking keeps the source active, unless the ingest thread already woke it
+            if(lane.frames.empty() || !lane.parked.exchange(false)) {
+                entries[id].active = false;
+                it = active.erase(it);
+                continue;
+            }
+        }
+
+        active.erase(it);
+
+        virtual_time = pass;
+
+        auto& source = entries[id];
+        source.pass = pass + stride_base / lane.weight;
+        active.emplace(source.pass, id);
 
-    if(it == q.end())
-        return (*q.begin()).first;
+        return id;
+    }
 
-    if(++it != q.end())
-        return (*it).first;
+    if(sources.find(current_queue_id) != sources.end())
+        return current_queue_id;
 
-    return (*q.begin()).first;
+    return (*sources.begin()).first;
 }
 
 template class basic_detection_service<cv::Mat>;
 template class detection_service_visitor<cv::Mat>;
+template class prioritize_load_strategy<cv::Mat>;
+template class prioritize_order_strategy<cv::Mat>;
+template class earliest_deadline_strategy<cv::Mat>;
+template class weighted_fair_strategy<cv::Mat>;
 //template class basic_detection_service<cv::GpuMat>;
\ No newline at end of file
@@ -0,0 +1,208 @@
+#include "../inc/service/frame_pool.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include <spdlog/spdlog.h>
+
+namespace
+{
+    constexpr std::size_t min_class = std::size_t(256) << 10;
+    constexpr std::size_t huge_page = std::size_t(2) << 20;
+    constexpr std::size_t alignment = 64;
+}
+
+frame_pool::pool_state::~pool_state()
+{
+    for(auto& [bytes, sizes]: classes)
+        for(const auto& buffer: sizes.free)
+            this->free(buffer);
+}
+
+frame_pool::slab frame_pool::pool_state::allocate(std::size_t bytes) const
+{
+    slab buffer;
+    buffer.size = bytes;
+    buffer.bytes = bytes;
+
+#ifdef __linux__
+    if(options.huge_pages)
+    {
+        const std::size_t mapped = (bytes + huge_page - 1) / huge_page * huge_page;
+
+        // reserved huge pages first, transparent ones when none are reserved
+        void* data = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+        if(data == MAP_FAILED)
+        {
+            data = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+            if(data == MAP_FAILED)
+                throw std::bad_alloc();
+
+            madvise(data, mapped, MADV_HUGEPAGE);
+        }
+
+        buffer.data = static_cast<unsigned char*>(data);
+        buffer.bytes = mapped;
+        buffer.mapped = true;
+
+        return buffer;
+    }
+#endif
+
+    buffer.data = static_cast<unsigned char*>(std::aligned_alloc(alignment, bytes));
+
+    if(!buffer.data)
+        throw std::bad_alloc();
+
+    return buffer;
+}
+
+void frame_pool::pool_state::free(const slab& buffer) const
+{
+#ifdef __linux__
+    if(buffer.mapped) {
+        munmap(buffer.data, buffer.bytes);
+        return;
+    }
+#endif
+
+    std::free(buffer.data);
+}
+
+void frame_pool::pool_state::release(const slab& buffer)
+{
+    std::lock_guard lock(mutex);
+
+    auto& sizes = classes[buffer.size];
+    sizes.stats.in_use--;
+
+    // over the budget after a burst of unusual sizes - shrink back
+    if(owned_bytes > options.max_bytes)
+    {
+        sizes.stats.slabs--;
+        owned_bytes -= buffer.bytes;
+
+        this->free(buffer);
+        return;
+    }
+
+    sizes.free.push_back(buffer);
+}
+
+std::size_t frame_pool::class_of(std::size_t bytes)
+{
+    std::size_t size = min_class;
+    while(size < bytes)
+        size <<= 1;
+
+    return size;
+}
+
+frame_pool& frame_pool::get_instance()
+{
+    static frame_pool pool; // lazy init
+    return pool;
+}
+
+void frame_pool::configure(const frame_pool_options& options)
+{
+    std::lock_guard lock(state->mutex);
+    state->options = options;
+
+    if(options.preallocate_frames == 0)
+        return;
+
+    const auto& shape = options.preallocate_shape;
+    const auto bytes = class_of(static_cast<std::size_t>(shape.width) * shape.height * CV_ELEM_SIZE(options.preallocate_type));
+    auto& sizes = state->classes[bytes];
+
+    for(unsigned i = 0; i < options.preallocate_frames; i++)
+    {
+        auto buffer = state->allocate(bytes);
+
+        // touch every page now, not on the first frames
+        std::memset(buffer.data, 0, buffer.bytes);
+
+        sizes.free.push_back(buffer);
+        sizes.stats.slab_bytes = bytes;
+        sizes.stats.slabs++;
+        sizes.stats.allocations++;
+        state->owned_bytes += buffer.bytes;
+    }
+
+    spdlog::info(
+        "[Frame pool]: {} slab(s) of {:.1f}MB preallocated{}",
+        options.preallocate_frames,
+        bytes / 1048576.0,
+        options.huge_pages ? " on huge pages" : "");
+}
+
+std::shared_ptr<cv::Mat> frame_pool::acquire(int rows, int cols, int type)
+{
+    const auto bytes = class_of(static_cast<std::size_t>(rows) * cols * CV_ELEM_SIZE(type));
+
+    slab buffer;
+
+    {
+        std::lock_guard lock(state->mutex);
+        auto& sizes = state->classes[bytes];
+
+        sizes.stats.slab_bytes = bytes;
+        sizes.stats.acquired++;
+
+        if(!sizes.free.empty())
+        {
+            buffer = sizes.free.back();
+            sizes.free.pop_back();
+        }
+        else
+        {
+            buffer = state->allocate(bytes);
+
+            sizes.stats.slabs++;
+            sizes.stats.allocations++;
+            state->owned_bytes += buffer.bytes;
+        }
+
+        sizes.stats.in_use++;
+        sizes.stats.high_water = std::max(sizes.stats.high_water, sizes.stats.in_use);
+    }
+
+    std::unique_ptr<cv::Mat> frame;
+
+    try {
+        frame = std::make_unique<cv::Mat>(rows, cols, type, buffer.data);
+    }
+    catch(...) {
+        state->release(buffer);
+        throw;
+    }
+
+    // the slab goes back once the last holder of the frame lets go of it, or right away when the shared_ptr cannot be set up
+    return std::shared_ptr<cv::Mat>(
+        frame.release(),
+        [state = this->state, buffer](cv::Mat* frame)
+        {
+            delete frame;
+            state->release(buffer);
+        });
+}
+
+std::vector<frame_pool_stats> frame_pool::get_stats()
+{
+    std::lock_guard lock(state->mutex);
+
+    std::vector<frame_pool_stats> stats;
+    for(const auto& [bytes, sizes]: state->classes)
+        stats.push_back(sizes.stats);
+
+    return stats;
+}
@@ -0,0 +1,85 @@
+#include "../inc/service/motion_gate.hpp"
+#include "../inc/ai/score_kernels.hpp"
+
+motion_gate::motion_gate(float threshold, std::chrono::milliseconds max_reuse_age)
+    : threshold(threshold), max_reuse_age(max_reuse_age)
+{
+}
+
+cv::Mat motion_gate::make_thumbnail(const cv::Mat& frame)
+{
+    cv::Mat decimated, small, thumbnail;
+
+    const cv::Size coarse(thumbnail_width * 4, thumbnail_height * 4);
+    const cv::Mat* source = &frame;
+
+    // a 4x4 area average per thumbnail pixel still keeps sensor noise out of it
+    if(frame.cols > coarse.width && frame.rows > coarse.height) {
+        cv::resize(frame, decimated, coarse, 0, 0, cv::INTER_NEAREST);
+        source = &decimated;
+    }
+
+    cv::resize(*source, small, cv::Size(thumbnail_width, thumbnail_height), 0, 0, cv::INTER_AREA);
+
+    if(small.channels() == 3)
+        cv::cvtColor(small, thumbnail, cv::COLOR_BGR2GRAY);
+    else if(small.channels() == 4)
+        cv::cvtColor(small, thumbnail, cv::COLOR_BGRA2GRAY);
+    else
+        thumbnail = small;
+
+    return thumbnail;
+}
+
+bool motion_gate::try_reuse(
+    const cv::Mat& frame, unsigned long long frame_id, clock::time_point now,
+    std::vector<detection>& reused, std::shared_ptr<const class_table>& reused_classes, std::chrono::milliseconds& age)
+{
+    if(frame.empty())
+        return false;
+
+    const auto thumbnail = make_thumbnail(frame);
+
+    std::lock_guard lock(mutex);
+
+    if(reusable && now - reference.at <= max_reuse_age)
+    {
+        const auto pixels = static_cast<std::size_t>(thumbnail.total());
+        const auto sad = kernels::sum_abs_diff(thumbnail.ptr<std::uint8_t>(), reference.thumbnail.ptr<std::uint8_t>(), pixels);
+
+        if(sad <= threshold * pixels)
+        {
+            reused = detections;
+            reused_classes = classes;
+            age = std::chrono::duration_cast<std::chrono::milliseconds>(now - reference.at);
+            return true;
+        }
+    }
+
+    // the frame is analysed, the current reference stays in use until its results are in
+    pending.push_back(snapshot{ thumbnail, frame_id, now });
+
+    if(pending.size() > max_pending)
+        pending.pop_front();
+
+    return false;
+}
+
+void motion_gate::analysed(unsigned long long frame_id, const std::vector<detection>& results, const std::shared_ptr<const class_table>& results_classes)
+{
+    std::lock_guard lock(mutex);
+
+    // frames of a source are analysed in order, older pending frames will not report anymore
+    while(!pending.empty() && pending.front().frame_id < frame_id)
+        pending.pop_front();
+
+    if(pending.empty() || pending.front().frame_id != frame_id)
+        return;
+
+    reference = std::move(pending.front());
+    pending.pop_front();
+
+    detections = results;
+    classes = results_classes;
+    reusable = true;
+}
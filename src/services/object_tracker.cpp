@@ -0,0 +1,199 @@
+#include "../inc/service/object_tracker.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+namespace
+{
+    // state: center x, center y, area, aspect ratio and the velocities of the first three; measurement: the first four
+    constexpr int state_size = 7;
+    constexpr int measurement_size = 4;
+
+    cv::Mat to_measurement(const detection& det)
+    {
+        cv::Mat z(measurement_size, 1, CV_32F);
+        z.at<float>(0) = det.x + det.width / 2.0f;
+        z.at<float>(1) = det.y + det.height / 2.0f;
+        z.at<float>(2) = det.width * det.height;
+        z.at<float>(3) = det.width / std::max(det.height, 1.0f);
+
+        return z;
+    }
+
+    cv::Rect2f to_box(const cv::Mat& state)
+    {
+        const float area = std::max(state.at<float>(2), 0.0f);
+        const float ratio = std::max(state.at<float>(3), 1e-3f);
+        const float width = std::sqrt(area * ratio);
+        const float height = width > 0.0f ? area / width : 0.0f;
+
+        return cv::Rect2f(state.at<float>(0) - width / 2.0f, state.at<float>(1) - height / 2.0f, width, height);
+    }
+
+    float iou(const cv::Rect2f& a, const cv::Rect2f& b)
+    {
+        const float x1 = std::max(a.x, b.x);
+        const float y1 = std::max(a.y, b.y);
+        const float x2 = std::min(a.x + a.width, b.x + b.width);
+        const float y2 = std::min(a.y + a.height, b.y + b.height);
+
+        const float intersection = std::max(0.0f, x2 - x1) * std::max(0.0f, y2 - y1);
+        const float united = a.width * a.height + b.width * b.height - intersection;
+
+        return united > 0.0f ? intersection / united : 0.0f;
+    }
+}
+
+object_tracker::object_tracker(const tracker_options& opts)
+    : options(opts)
+{
+}
+
+object_tracker::track object_tracker::create_track(const detection& det)
+{
+    track t;
+    t.id = next_id++;
+    t.class_id = det.class_id;
+    t.confidence = det.confidence;
+    t.predicted = cv::Rect2f(det.x, det.y, det.width, det.height);
+
+    // noise settings of the reference SORT implementation
+    auto& kf = t.filter;
+    kf.init(state_size, measurement_size, 0, CV_32F);
+
+    cv::setIdentity(kf.transitionMatrix);
+    for(int i = 0; i < 3; i++)
+        kf.transitionMatrix.at<float>(i, i + 4) = 1.0f;
+
+    cv::setIdentity(kf.measurementMatrix);
+    cv::setIdentity(kf.measurementNoiseCov, cv::Scalar::all(1.0));
+    kf.measurementNoiseCov.at<float>(2, 2) = 10.0f;
+    kf.measurementNoiseCov.at<float>(3, 3) = 10.0f;
+
+    cv::setIdentity(kf.processNoiseCov, cv::Scalar::all(1.0));
+    for(int i = 4; i < state_size; i++)
+        kf.processNoiseCov.at<float>(i, i) = 0.01f;
+    kf.processNoiseCov.at<float>(6, 6) = 0.0001f;
+
+    // unknown velocities start with a high uncertainty
+    cv::setIdentity(kf.errorCovPost, cv::Scalar::all(10.0));
+    for(int i = 4; i < state_size; i++)
+        kf.errorCovPost.at<float>(i, i) = 10000.0f;
+
+    const auto z = to_measurement(det);
+    kf.statePost = cv::Mat::zeros(state_size, 1, CV_32F);
+    for(int i = 0; i < measurement_size; i++)
+        kf.statePost.at<float>(i) = z.at<float>(i);
+
+    return t;
+}
+
+void object_tracker::advance(track& t)
+{
+    auto& state = t.filter.statePost;
+
+    // the area must not shrink below zero
+    if(state.at<float>(2) + state.at<float>(6) <= 0.0f)
+        state.at<float>(6) = 0.0f;
+
+    t.predicted = to_box(t.filter.predict());
+    t.since_update++;
+}
+
+void object_tracker::update(std::vector<detection>& detections)
+{
+    for(auto& t: tracks)
+        this->advance(t);
+
+    matched_tracks.assign(tracks.size(), false);
+    matched_detections.assign(detections.size(), false);
+
+    // greedy association, the best overlapping pairs first (same class only)
+    std::vector<std::tuple<float, std::size_t, std::size_t>> pairs;
+    for(std::size_t t = 0; t < tracks.size(); t++)
+        for(std::size_t d = 0; d < detections.size(); d++)
+        {
+            if(tracks[t].class_id != detections[d].class_id)
+                continue;
+
+            const auto& det = detections[d];
+            const float overlap = iou(tracks[t].predicted, cv::Rect2f(det.x, det.y, det.width, det.height));
+
+            if(overlap >= options.iou_threshold)
+                pairs.emplace_back(overlap, t, d);
+        }
+
+    std::sort(pairs.begin(), pairs.end(), [](const auto& a, const auto& b) { return std::get<0>(a) > std::get<0>(b); });
+
+    for(const auto& [overlap, t, d]: pairs)
+    {
+        if(matched_tracks[t] || matched_detections[d])
+            continue;
+
+        matched_tracks[t] = true;
+        matched_detections[d] = true;
+
+        auto& matched = tracks[t];
+        matched.filter.correct(to_measurement(detections[d]));
+        matched.confidence = detections[d].confidence;
+        matched.since_update = 0;
+
+        detections[d].track_id = matched.id;
+    }
+
+    // tracks that went unmatched for too long are dropped, new objects start a track
+    std::vector<track> live;
+    live.reserve(tracks.size() + detections.size());
+
+    for(std::size_t t = 0; t < tracks.size(); t++)
+        if(matched_tracks[t] || tracks[t].since_update <= options.max_age)
+            live.push_back(std::move(tracks[t]));
+
+    for(std::size_t d = 0; d < detections.size(); d++)
+    {
+        if(matched_detections[d])
+            continue;
+
+        live.push_back(this->create_track(detections[d]));
+        detections[d].track_id = live.back().id;
+    }
+
+    tracks = std::move(live);
+    detection_wanted.store(false, std::memory_order_relaxed);
+}
+
+void object_tracker::predict(std::vector<detection>& predicted)
+{
+    predicted.clear();
+
+    float confidence = 0.0f;
+    std::size_t live = 0;
+
+    for(auto& t: tracks)
+    {
+        this->advance(t);
+
+        if(t.since_update > options.max_age)
+            continue;
+
+        detection det;
+        det.x = t.predicted.x;
+        det.y = t.predicted.y;
+        det.width = t.predicted.width;
+        det.height = t.predicted.height;
+        det.class_id = t.class_id;
+        det.confidence = t.confidence * std::pow(options.confidence_decay, static_cast<float>(t.since_update));
+        det.track_id = t.id;
+
+        confidence += det.confidence;
+        live++;
+
+        predicted.push_back(det);
+    }
+
+    tracks.erase(std::remove_if(tracks.begin(), tracks.end(), [&](const track& t) { return t.since_update > options.max_age; }), tracks.end());
+
+    // with nothing to track there is nothing to lose either, keyframes alone pick up new objects
+    detection_wanted.store(live > 0 && confidence / live < options.min_confidence, std::memory_order_relaxed);
+}
@@ -1,4 +1,5 @@
 #include "../inc/service/processing_service.hpp"
+#include "../inc/service/trace_recorder.hpp"
 
 template<typename T>
 basic_processing_service<T>* basic_processing_service<T>::exclude_objects(std::vector<unsigned> excluded) {
@@ -59,7 +60,7 @@ std::thread basic_processing_service<T>::run_background_service()
 }
 
 template <typename T>
-void basic_processing_service<T>::apply_results(std::shared_ptr<T> img, const std::vector<detection>& results)
+void basic_processing_service<T>::apply_results(std::shared_ptr<T> img, const std::vector<detection>& results, const class_table& classes)
 {
     if(results.empty())
         return;
@@ -91,13 +92,12 @@ void basic_processing_service<T>::apply_results(std::shared_ptr<T> img, const st
 
         auto& ref = *(img.get());
 
-        auto box = detection.box;
-        auto classId = detection.class_id;
-        const auto& color = detection.color;
+        const auto box = detection.box();
+        const auto& color = classes.color(detection.class_id);
         cv::rectangle(ref, box, color, 3);
         
         std::ostringstream stringStream;
-        stringStream << detection.class_name << " - " << std::setprecision(4) << detection.confidence*100 << "%";
+        stringStream << classes.name(detection.class_id) << " - " << std::setprecision(4) << detection.confidence*100 << "%";
 
         cv::rectangle(ref, cv::Point(box.x, box.y - 20), cv::Point(box.x + box.width, box.y), color, cv::FILLED);
         cv::putText(ref,  stringStream.str(), cv::Point(box.x, box.y - 5), cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 0, 0));
@@ -105,10 +105,12 @@ void basic_processing_service<T>::apply_results(std::shared_ptr<T> img, const st
 }
 
 template <typename T>
-void basic_processing_service<T>::push_results(unsigned src_id, std::shared_ptr<T> frame, const std::vector<detection>& detections)
+void basic_processing_service<T>::push_results(unsigned src_id, std::shared_ptr<T> frame, const std::vector<detection>& detections, std::shared_ptr<const class_table> classes, frame_trace trace, result_info info)
 {
+    trace.start(trace_stage::result_queue);
+
     std::lock_guard lock(sync);
-    results.push(std::make_tuple(src_id, frame, detections));
+    results.push(std::make_tuple(src_id, frame, detections, std::move(classes), trace, info));
 }
 
 template<typename T>
@@ -130,27 +132,33 @@ void basic_processing_service<T>::run()
 {
     while(true)
     {
+        std::unique_lock lock(sync);
+
         if(results.empty())
         {
+            lock.unlock();
             //std::this_thread::yield();
             std::this_thread::sleep_for(std::chrono::milliseconds(100));
             continue;
         }
 
-        auto& [id, frame, detections] = results.front();
+        auto [id, frame, detections, classes, trace, info] = std::move(results.front());
+        results.pop();
+        lock.unlock();
+
+        trace.stop(trace_stage::result_queue);
 
         if(json_publisher)
-            json_publisher->publish(id, detections, 5);
+            json_publisher->publish(id, detections, *classes, trace, info);
 
-        if(frame_publisher)
+        // results answered from the cache come without a decoded frame
+        if(frame_publisher && frame)
         {
-            //this->apply_results(frame, detections);
+            //this->apply_results(frame, detections, *classes);
            // frame_publisher->publish_image(*(frame.get()), id);
         }
 
-        std::unique_lock lock(sync);
-        results.pop();
-        lock.unlock();
+        trace_recorder::get_instance().record(trace);
     }
 }
 
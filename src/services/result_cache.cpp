@@ -0,0 +1,186 @@
+#include "../inc/service/result_cache.hpp"
+
+#include <bitset>
+#include <cstring>
+
+namespace
+{
+    constexpr std::uint64_t prime1 = 0x9E3779B185EBCA87ull;
+    constexpr std::uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+    constexpr std::uint64_t prime3 = 0x165667B19E3779F9ull;
+    constexpr std::uint64_t prime4 = 0x85EBCA77C2B2AE63ull;
+    constexpr std::uint64_t prime5 = 0x27D4EB2F165667C5ull;
+
+    inline std::uint64_t rotl(std::uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+    inline std::uint64_t read64(const unsigned char* p)
+    {
+        std::uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    inline std::uint32_t read32(const unsigned char* p)
+    {
+        std::uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    inline std::uint64_t lane_round(std::uint64_t acc, std::uint64_t input) { return rotl(acc + input * prime2, 31) * prime1; }
+
+    inline std::uint64_t merge_round(std::uint64_t acc, std::uint64_t value) { return (acc ^ lane_round(0, value)) * prime1 + prime4; }
+}
+
+result_cache::result_cache(std::size_t capacity, unsigned max_distance)
+    : capacity(std::max<std::size_t>(1, capacity)), max_distance(max_distance)
+{
+}
+
+std::uint64_t result_cache::hash_bytes(const void* data, std::size_t size)
+{
+    const auto* p = static_cast<const unsigned char*>(data);
+    const auto* end = p + size;
+
+    std::uint64_t h;
+
+    // four independent lanes keep the multipliers busy on large frames
+    if(size >= 32)
+    {
+        std::uint64_t v1 = prime1 + prime2;
+        std::uint64_t v2 = prime2;
+        std::uint64_t v3 = 0;
+        std::uint64_t v4 = 0 - prime1;
+
+        for(; p + 32 <= end; p += 32)
+        {
+            v1 = lane_round(v1, read64(p));
+            v2 = lane_round(v2, read64(p + 8));
+            v3 = lane_round(v3, read64(p + 16));
+            v4 = lane_round(v4, read64(p + 24));
+        }
+
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = merge_round(h, v1);
+        h = merge_round(h, v2);
+        h = merge_round(h, v3);
+        h = merge_round(h, v4);
+    }
+    else h = prime5;
+
+    h += static_cast<std::uint64_t>(size);
+
+    for(; p + 8 <= end; p += 8)
+        h = rotl(h ^ lane_round(0, read64(p)), 27) * prime1 + prime4;
+
+    if(p + 4 <= end) {
+        h = rotl(h ^ (static_cast<std::uint64_t>(read32(p)) * prime1), 23) * prime2 + prime3;
+        p += 4;
+    }
+
+    for(; p < end; p++)
+        h = rotl(h ^ (*p * prime5), 11) * prime1;
+
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    h *= prime3;
+    h ^= h >> 32;
+
+    return h;
+}
+
+std::uint64_t result_cache::perceptual_hash(const cv::Mat& frame)
+{
+    if(frame.empty())
+        return 0;
+
+    cv::Mat small, gray;
+    cv::resize(frame, small, cv::Size(9, 8), 0, 0, cv::INTER_AREA);
+
+    if(small.channels() == 3)
+        cv::cvtColor(small, gray, cv::COLOR_BGR2GRAY);
+    else if(small.channels() == 4)
+        cv::cvtColor(small, gray, cv::COLOR_BGRA2GRAY);
+    else
+        gray = small;
+
+    std::uint64_t hash = 0;
+
+    for(int y = 0; y < 8; y++)
+    {
+        const auto* row = gray.ptr<std::uint8_t>(y);
+
+        for(int x = 0; x < 8; x++)
+            hash = (hash << 1) | (row[x] < row[x + 1] ? 1u : 0u);
+    }
+
+    return hash;
+}
+
+std::optional<cached_result> result_cache::hit(std::list<entry>::iterator it)
+{
+    entries.splice(entries.begin(), entries, it);
+    hits++;
+
+    return it->result;
+}
+
+std::optional<cached_result> result_cache::find_content(std::uint64_t content)
+{
+    std::lock_guard lock(mutex);
+    lookups++;
+
+    auto it = by_content.find(content);
+    if(it == by_content.end())
+        return std::nullopt;
+
+    return this->hit(it->second);
+}
+
+std::optional<cached_result> result_cache::find_similar(std::uint64_t perceptual)
+{
+    std::lock_guard lock(mutex);
+
+    // a frame that missed by content is looked up again once decoded, count it once
+    for(auto it = entries.begin(); it != entries.end(); ++it)
+    {
+        if(!it->key.has_perceptual)
+            continue;
+
+        if(std::bitset<64>(it->key.perceptual ^ perceptual).count() <= max_distance)
+            return this->hit(it);
+    }
+
+    return std::nullopt;
+}
+
+void result_cache::store(const frame_key& key, const std::vector<detection>& detections, const std::shared_ptr<const class_table>& classes)
+{
+    std::lock_guard lock(mutex);
+
+    if(key.content != 0)
+    {
+        auto known = by_content.find(key.content);
+        if(known != by_content.end()) {
+            entries.erase(known->second);
+            by_content.erase(known);
+        }
+    }
+
+    entries.push_front(entry{ key, cached_result{ detections, classes } });
+
+    if(key.content != 0)
+        by_content[key.content] = entries.begin();
+
+    while(entries.size() > capacity)
+    {
+        const auto& oldest = entries.back();
+
+        auto indexed = by_content.find(oldest.key.content);
+        if(indexed != by_content.end() && indexed->second == std::prev(entries.end()))
+            by_content.erase(indexed);
+
+        entries.pop_back();
+    }
+}
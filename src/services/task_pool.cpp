@@ -0,0 +1,114 @@
+#include "../inc/service/task_pool.hpp"
+
+#include <algorithm>
+
+#include <spdlog/spdlog.h>
+
+namespace
+{
+    // index of the pool worker running on this thread, none outside of the pool
+    constexpr std::size_t no_worker = static_cast<std::size_t>(-1);
+    thread_local const task_pool* current_pool = nullptr;
+    thread_local std::size_t current_worker = no_worker;
+}
+
+task_pool::task_pool(unsigned threads)
+{
+    const unsigned count = std::max(1u, threads);
+
+    queues.reserve(count);
+    for(unsigned i = 0; i < count; i++)
+        queues.emplace_back(std::make_unique<worker_queue>());
+
+    workers.reserve(count);
+    for(unsigned i = 0; i < count; i++)
+        workers.emplace_back([this, i]() { this->run_worker(i); });
+}
+
+task_pool::~task_pool()
+{
+    stopping = true;
+
+    // pending has to be non-zero for the workers to wake up
+    work.post(workers.size());
+    work.release();
+
+    for(auto& worker: workers)
+        worker.join();
+}
+
+void task_pool::submit(task next)
+{
+    const std::size_t target = current_pool == this && current_worker != no_worker
+        ? current_worker
+        : next_queue++ % queues.size();
+
+    {
+        auto& queue = *queues[target];
+        std::lock_guard lock(queue.mutex);
+        queue.tasks.push_back(std::move(next));
+    }
+
+    work.post();
+}
+
+bool task_pool::try_take(std::size_t self, task& next)
+{
+    {
+        auto& own = *queues[self];
+        std::lock_guard lock(own.mutex);
+
+        if(!own.tasks.empty()) {
+            next = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    for(std::size_t i = 1; i < queues.size(); i++)
+    {
+        auto& victim = *queues[(self + i) % queues.size()];
+        std::lock_guard lock(victim.mutex);
+
+        if(!victim.tasks.empty()) {
+            next = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void task_pool::run_worker(std::size_t self)
+{
+    current_pool = this;
+    current_worker = self;
+
+    task next;
+
+    while(!stopping)
+    {
+        // read before looking for work, so a task submitted meanwhile is not missed
+        const auto seen_version = work.current_version();
+
+        if(!try_take(self, next)) {
+            work.wait(seen_version);
+            continue;
+        }
+
+        work.consume(1);
+
+        try {
+            next();
+        }
+        catch(const std::exception& e) {
+            spdlog::error("[Task pool]: {}", e.what());
+        }
+        catch(...) {
+            spdlog::error("[Task pool]: Unknown Error");
+        }
+
+        next = nullptr;
+    }
+}
@@ -0,0 +1,148 @@
+#include "../inc/service/trace_recorder.hpp"
+
+#include <cstdio>
+#include <fstream>
+
+#include <spdlog/spdlog.h>
+
+namespace
+{
+    constexpr std::size_t export_interval = 100;
+
+    stage_latency summarize(const std::string& name, const latency_histogram& histogram)
+    {
+        stage_latency latency;
+        latency.stage = name;
+        latency.count = histogram.count();
+        latency.p50 = histogram.percentile(0.5);
+        latency.p99 = histogram.percentile(0.99);
+        latency.p999 = histogram.percentile(0.999);
+        latency.max = histogram.max();
+
+        return latency;
+    }
+}
+
+trace_recorder& trace_recorder::get_instance()
+{
+    static trace_recorder recorder; // lazy init
+    return recorder;
+}
+
+void trace_recorder::set_sampling(unsigned every, const std::string& path)
+{
+    std::lock_guard lock(mutex);
+
+    this->sample_every = every;
+    this->trace_path = path;
+}
+
+void trace_recorder::record(const frame_trace& trace)
+{
+    std::unique_lock lock(mutex);
+
+    for(std::size_t i = 0; i < trace_stage_count; i++)
+    {
+        const auto stage = static_cast<trace_stage>(i);
+
+        if(trace.has(stage))
+            stages[i].record(trace.duration(stage).count());
+    }
+
+    // the transport span starts at capture when the frame was stamped
+    const auto first = trace.has(trace_stage::transport) ? trace_stage::transport : trace_stage::ingest;
+
+    if(trace.has(first) && trace.has(trace_stage::publish))
+    {
+        const auto total = trace.end[frame_trace::index(trace_stage::publish)] - trace.begin[frame_trace::index(first)];
+        end_to_end.record(std::chrono::duration_cast<std::chrono::microseconds>(total).count());
+    }
+
+    if(sample_every == 0 || traces_seen++ % sample_every != 0)
+        return;
+
+    samples.push_back(trace);
+    if(samples.size() > max_samples)
+        samples.pop_front();
+
+    if(trace_path.empty() || ++samples_since_export < export_interval)
+        return;
+
+    samples_since_export = 0;
+
+    // write a copy outside of the lock, the publishing thread should not wait for the disk
+    const auto window = samples;
+    const auto path = trace_path;
+    lock.unlock();
+
+    this->write_chrome_trace(path, window);
+}
+
+std::vector<stage_latency> trace_recorder::get_latencies()
+{
+    std::lock_guard lock(mutex);
+
+    std::vector<stage_latency> latencies;
+    latencies.reserve(trace_stage_count + 1);
+
+    for(std::size_t i = 0; i < trace_stage_count; i++)
+        latencies.push_back(summarize(to_string(static_cast<trace_stage>(i)), stages[i]));
+
+    latencies.push_back(summarize("end_to_end", end_to_end));
+
+    return latencies;
+}
+
+void trace_recorder::export_chrome_trace(const std::string& path)
+{
+    std::unique_lock lock(mutex);
+    const auto window = samples;
+    lock.unlock();
+
+    this->write_chrome_trace(path, window);
+}
+
+void trace_recorder::write_chrome_trace(const std::string& path, const std::deque<frame_trace>& traces)
+{
+    std::lock_guard lock(export_mutex);
+
+    // written next to the target and renamed over it, readers never see a half written file
+    const auto partial = path + ".partial";
+    std::ofstream file(partial, std::ios::trunc);
+
+    if(!file) {
+        spdlog::error("[Trace recorder]: Could not open {}", partial);
+        return;
+    }
+
+    // one complete ("X") event per stage, a row (tid) per source, timestamps in microseconds since start
+    file << "{\"traceEvents\":[";
+
+    bool first = true;
+    for(const auto& trace: traces)
+    {
+        for(std::size_t i = 0; i < trace_stage_count; i++)
+        {
+            const auto stage = static_cast<trace_stage>(i);
+
+            if(!trace.has(stage))
+                continue;
+
+            const auto ts = std::chrono::duration_cast<std::chrono::microseconds>(trace.begin[i] - epoch).count();
+
+            file << (first ? "" : ",") << "\n{\"name\":\"" << to_string(stage) << "\",\"cat\":\"frame\",\"ph\":\"X\""
+                 << ",\"ts\":" << ts
+                 << ",\"dur\":" << trace.duration(stage).count()
+                 << ",\"pid\":1,\"tid\":" << trace.source_id
+                 << ",\"args\":{\"frame\":" << trace.frame_id << ",\"captured\":" << trace.captured_ms << "}}";
+
+            first = false;
+        }
+    }
+
+    file << "\n]}\n";
+    file.close();
+
+    if(!file || std::rename(partial.c_str(), path.c_str()) != 0)
+        spdlog::error("[Trace recorder]: Could not write {}", path);
+}